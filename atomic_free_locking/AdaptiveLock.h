@@ -0,0 +1,224 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _adaptive_lock_h
+#define _adaptive_lock_h
+
+#include <cstdint>
+#include <cassert>
+#include <mutex>
+
+#include "Calibration.h"
+#include "PetersonLock.h"
+
+/**
+ * A two-thread lock which switches between spinning and parking according to recent contention.
+ *
+ * The fenced PetersonLock is hard to beat when the threads rarely collide, but under sustained
+ * contention it burns a core spinning while the holder runs. A std::mutex parks the waiter in the
+ * kernel instead, which costs more per handoff but wastes nothing while waiting. This lock runs
+ * one protocol at a time and tracks how often acquisitions are contended, switching protocol when
+ * the estimate crosses a threshold.
+ *
+ * Switching safely is the interesting part. The current protocol is only ever changed by a thread
+ * which holds the lock under that protocol, and it acquires the new protocol's lock *before*
+ * publishing the change. So at every instant, whoever holds the lock of the current protocol is
+ * the one true holder. A thread which acquires the lock of a stale protocol notices the change
+ * when it rechecks m_protocol afterwards, and backs off to try again.
+ *
+ * The contention estimate and switch bookkeeping are only touched by the holder, so they need no
+ * synchronization of their own.
+ *
+ * Under the spinning protocol, a thread which finds the other thread interested first spins with
+ * pause for up to the machine's calibrated spin budget, as long as a yield would cost, before
+ * entering PetersonLock::acquire. Short waits thus never pay for a trip into the scheduler.
+ */
+template <typename WaitFunction>
+class AdaptiveLock
+{
+public:
+    enum class Protocol : uint8_t
+    {
+        SPIN,   ///< Use the fenced PetersonLock.
+        PARK,   ///< Use a std::mutex, which parks waiters in the kernel.
+    };
+
+private:
+    /// The weight of a new sample in the contention estimate is 2^-DECAY_SHIFT.
+    static constexpr unsigned DECAY_SHIFT = 4;
+
+    /// The fixed point value of a contended acquisition. An uncontended one has value zero.
+    static constexpr uint32_t CONTENDED = 1u << 16;
+
+    /// Switch to parking when more than half of recent acquisitions were contended...
+    static constexpr uint32_t PARK_THRESHOLD = CONTENDED / 2;
+
+    /// ...and back to spinning once fewer than one in eight were.
+    static constexpr uint32_t SPIN_THRESHOLD = CONTENDED / 8;
+
+    /// Also the identity lock order validation knows this lock by; it forgets itself when destroyed.
+    PetersonLock<WaitFunction, true> m_spin_lock;
+    std::mutex m_park_lock;
+
+    /// The protocol new acquisitions should use. Only changed by a holder; see class comment.
+    volatile Protocol m_protocol = Protocol::SPIN;
+
+    /// For both threads, the protocol under which it holds the lock. Only touched by that thread.
+    Protocol m_held[2];
+
+    /// Exponentially decaying fraction of contended acquisitions, in units of CONTENDED.
+    uint32_t m_contention = 0;
+
+    /// The number of protocol switches made so far.
+    unsigned m_switch_count = 0;
+
+    /// The most pauses to spin for before acquiring under the spinning protocol.
+    const uint32_t m_spin_budget;
+
+public:
+    AdaptiveLock(WaitFunction wait_function)
+        : m_spin_lock(wait_function)
+        , m_spin_budget(calibration().spin_budget)
+    {}
+
+    /// Acquire the lock for the specified thread (0 or 1), waiting until it is available.
+    void acquire(bool thread)
+    {
+        while (true) {
+            const Protocol protocol = m_protocol;
+            const bool contended = acquire_protocol(thread, protocol);
+
+            if (protocol == m_protocol) {
+                m_held[thread] = protocol;
+                record_contention(thread, contended);
+                return;
+            }
+
+            // The holder switched protocols while we were waiting; try again with the new one.
+            release_protocol(thread, protocol);
+        }
+    }
+
+    /// Release the already-acquired lock for the specified thread (0 or 1).
+    void release(bool thread)
+    {
+        release_protocol(thread, m_held[thread]);
+    }
+
+    /// The protocol currently in use. Only meaningful while holding the lock or when quiescent.
+    Protocol protocol() const { return m_protocol; }
+
+    /// The number of protocol switches made. Only meaningful while holding the lock or when quiescent.
+    unsigned switch_count() const { return m_switch_count; }
+
+    /// Adaptive locks don't keep an ownership history.
+    const LockHistory *history() const { return nullptr; }
+
+private:
+    /// Acquire the underlying lock of the specified protocol, returning whether we had to wait.
+    bool acquire_protocol(bool thread, Protocol protocol)
+    {
+        bool contended;
+
+        if (protocol == Protocol::SPIN) {
+            contended = spin_while_interested(thread);
+            contended = m_spin_lock.acquire(thread) > 0 || contended;
+        } else {
+            contended = !m_park_lock.try_lock();
+
+            if (contended) {
+                m_park_lock.lock();
+            }
+        }
+
+        // Keep the compiler from hoisting the caller's recheck of m_protocol above the
+        // acquisition. The hardware won't reorder the loads on x86.
+        asm volatile("" ::: "memory");
+
+        return contended;
+    }
+
+    /**
+     * Spin with pause while the other thread is interested in the spin lock, for at most the spin
+     * budget, returning whether we spun at all. Only reads the lock, so it can't affect its
+     * correctness.
+     */
+    bool spin_while_interested(bool thread)
+    {
+        uint32_t spins = 0;
+
+        while (spins < m_spin_budget && m_spin_lock.state().interested[!thread]) {
+            asm volatile("pause" ::: "memory");
+            ++spins;
+        }
+
+        return spins > 0;
+    }
+
+    void release_protocol(bool thread, Protocol protocol)
+    {
+        // Likewise, keep any preceding store to m_protocol ahead of the releasing store.
+        asm volatile("" ::: "memory");
+
+        if (protocol == Protocol::SPIN) {
+            m_spin_lock.release(thread);
+        } else {
+            m_park_lock.unlock();
+        }
+    }
+
+    /// Fold a new sample into the contention estimate and switch protocols if it calls for it.
+    void record_contention(bool thread, bool contended)
+    {
+        m_contention += (contended ? CONTENDED : 0) >> DECAY_SHIFT;
+        m_contention -= m_contention >> DECAY_SHIFT;
+
+        const Protocol current = m_held[thread];
+
+        if (current == Protocol::SPIN && m_contention > PARK_THRESHOLD) {
+            switch_protocol(thread, Protocol::PARK);
+        } else if (current == Protocol::PARK && m_contention < SPIN_THRESHOLD) {
+            switch_protocol(thread, Protocol::SPIN);
+        }
+    }
+
+    /// Switch to the specified protocol while holding the lock under the other one.
+    void switch_protocol(bool thread, Protocol target)
+    {
+        const Protocol current = m_held[thread];
+
+        assert(current != target);
+
+        // Take the new protocol's lock first. Anybody holding it got there using a stale protocol
+        // and will release it without waiting on anything, so this cannot deadlock.
+        acquire_protocol(thread, target);
+
+        m_protocol = target;
+        m_held[thread] = target;
+        ++m_switch_count;
+
+        release_protocol(thread, current);
+    }
+};
+
+#endif // _adaptive_lock_h
@@ -0,0 +1,125 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "AdaptiveLock.h"
+#include "Barrier.h"
+#include "Benchmarks.h"
+#include "Latency.h"
+#include "MutexLock.h"
+#include "PetersonLock.h"
+
+using std::this_thread::yield;
+using WaitFunction = __typeof__(&yield);
+
+namespace {
+
+/// The phases of the workload. Phases alternate between the two threads rarely colliding and
+/// hammering the lock back to back.
+const struct
+{
+    const char *name;
+    unsigned    think_time;   ///< Iterations of private work between acquisitions.
+} phases[] = {
+    { "quiet",    2000 },
+    { "busy",        0 },
+    { "quiet",    2000 },
+    { "busy",        0 },
+};
+
+const unsigned PHASE_COUNT = sizeof(phases) / sizeof(phases[0]);
+
+/**
+ * Run every phase of the workload against the specified lock.
+ *
+ * Fills in the mean time per acquisition for each phase, in nanoseconds, as observed by thread 0.
+ */
+template <typename Lock>
+void time_lock(Lock &lock, unsigned loop_count, double (&result)[PHASE_COUNT])
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    SenseReversingBarrier<WaitFunction> barrier(2, &yield);
+    std::thread thread[2];
+    volatile int shared_value = 0;
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid] = std::thread([&, tid]()
+        {
+            for (unsigned phase = 0; phase < PHASE_COUNT; ++phase) {
+                const unsigned think_time = phases[phase].think_time;
+
+                barrier.wait(tid);
+                const auto start = clock::now();
+
+                for (unsigned i = 0; i < loop_count; ++i) {
+                    lock.acquire(bool(tid));
+                    shared_value = shared_value + 1;
+                    lock.release(bool(tid));
+
+                    think(think_time);
+                }
+
+                // Wait for the other thread so the measurement covers both.
+                barrier.wait(tid);
+
+                if (tid == 0) {
+                    result[phase] = std::chrono::duration<double, std::nano>(clock::now() - start)
+                                        .count() / loop_count;
+                }
+            }
+        });
+    }
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid].join();
+    }
+}
+
+} // anonymous namespace
+
+void benchmark_adaptive_lock(unsigned loop_count)
+{
+    double peterson[PHASE_COUNT], mutex[PHASE_COUNT], adaptive[PHASE_COUNT];
+
+    PetersonLock<WaitFunction, true> peterson_lock(&yield);
+    MutexLock<WaitFunction> mutex_lock(&yield);
+    AdaptiveLock<WaitFunction> adaptive_lock(&yield);
+
+    time_lock(peterson_lock, loop_count, peterson);
+    time_lock(mutex_lock, loop_count, mutex);
+    time_lock(adaptive_lock, loop_count, adaptive);
+
+    printf("Time per iteration (ns), %u iterations per thread per phase\n", loop_count);
+    printf("%8s %12s %12s %12s\n", "phase", "peterson", "mutex", "adaptive");
+
+    for (unsigned phase = 0; phase < PHASE_COUNT; ++phase) {
+        printf("%8s %12.1f %12.1f %12.1f\n",
+               phases[phase].name, peterson[phase], mutex[phase], adaptive[phase]);
+    }
+
+    printf("Adaptive lock switched protocols %u times\n", adaptive_lock.switch_count());
+}
@@ -0,0 +1,242 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _async_lock_h
+#define _async_lock_h
+
+#include <cassert>
+#include <coroutine>
+
+#include "Executor.h"
+
+/**
+ * A PetersonLock for coroutines: co_await lock.acquire_async(slot) suspends the awaiting
+ * coroutine instead of spinning, so the event loop thread stays free to run other coroutines.
+ *
+ * Each of the two slots belongs to one thread running an Executor, and any number of coroutines on
+ * that thread may share the slot. Between the two threads the lock runs the fenced Peterson
+ * protocol; within a slot, waiters queue in FIFO order, and release() hands the lock straight to
+ * the next of them without giving it up. That is, unless the other thread is interested, in
+ * which case the slot yields to it just as a fresh acquire would, keeping Peterson's fairness.
+ *
+ * A slot which loses the race parks: it flags itself as parked and suspends its waiters. When the
+ * other thread gives up the lock it checks for a parked slot and posts a wakeup to that slot's
+ * executor, which grants the lock to the slot's first waiter on its own thread. Both sides store
+ * their flag, fence, and then load the other's, the same protocol acquire() relies on, so at least
+ * one of them notices the other and no wakeup is ever lost. If both notice, the wakeup arrives to
+ * find the lock already granted and is ignored.
+ *
+ * The lock must outlive any wakeups posted for it, and each slot must only be used from its
+ * executor's thread. Likewise, an executor must outlive every lock it has waited on: a thread
+ * which has already read the other slot's executor may post a wakeup to it after the other
+ * thread has been granted the lock and finished, so a thread-local executor is not enough.
+ */
+template <bool fenced>
+class AsyncPetersonLock
+{
+public:
+    class Awaiter
+    {
+        friend class AsyncPetersonLock;
+
+        AsyncPetersonLock &m_lock;
+        const bool m_slot;
+        std::coroutine_handle<> m_handle;
+        Awaiter *m_next = nullptr;
+
+    public:
+        Awaiter(AsyncPetersonLock &lock, bool slot) : m_lock(lock), m_slot(slot) {}
+
+        bool await_ready() { return m_lock.try_acquire(m_slot); }
+        void await_suspend(std::coroutine_handle<> handle) { m_lock.wait(m_slot, this, handle); }
+        void await_resume() const {}
+    };
+
+private:
+    /// The Peterson protocol state, shared by both threads.
+    volatile bool m_interested[2] = { false, false };
+    volatile bool m_thread_priority = false;
+
+    /// For both slots, whether the slot's waiters are suspended awaiting the other thread.
+    volatile bool m_parked[2] = { false, false };
+
+    /// For both slots, the executor to post wakeups to. Written before m_parked is set.
+    Executor *volatile m_executor[2] = { nullptr, nullptr };
+
+    /// For both slots, whether a coroutine in the slot holds the lock. Only touched by the slot.
+    bool m_held[2] = { false, false };
+
+    /// For both slots, the queue of suspended waiters. Only touched by the slot.
+    Awaiter *m_head[2] = { nullptr, nullptr };
+    Awaiter *m_tail[2] = { nullptr, nullptr };
+
+public:
+    AsyncPetersonLock() = default;
+    AsyncPetersonLock(const AsyncPetersonLock&) = delete;
+    AsyncPetersonLock &operator=(const AsyncPetersonLock&) = delete;
+
+    /// Acquire the lock for the specified slot (0 or 1), suspending until it is available.
+    Awaiter acquire_async(bool slot) { return Awaiter(*this, slot); }
+
+    /// Release the already-acquired lock for the specified slot (0 or 1).
+    void release(bool slot)
+    {
+        assert(m_held[slot]);
+
+        const bool other_slot = !slot;
+
+        if (!m_head[slot]) {
+            m_held[slot] = false;
+
+            asm volatile("" ::: "memory");
+            m_interested[slot] = false;
+            fence();
+
+            wake_if_parked(other_slot);
+            return;
+        }
+
+        if (!m_interested[other_slot]) {
+            // Nobody else wants it; hand it straight to the next local waiter.
+            grant(slot);
+            return;
+        }
+
+        // Yield to the other slot, then wait our turn as a fresh acquire would.
+        m_held[slot] = false;
+        m_executor[slot] = Executor::current();
+        m_parked[slot] = true;
+
+        asm volatile("" ::: "memory");
+        m_thread_priority = other_slot;
+        fence();
+
+        wake_if_parked(other_slot);
+        check_parked(slot);
+    }
+
+private:
+    static void fence()
+    {
+        if (fenced) {
+            asm volatile("mfence" ::: "memory");
+        } else {
+            asm volatile("" ::: "memory");
+        }
+    }
+
+    /// Whether the specified slot, having announced its interest, may take the lock.
+    bool available(bool slot) const
+    {
+        const bool other_slot = !slot;
+
+        return !(m_interested[other_slot] && m_thread_priority == other_slot);
+    }
+
+    /// Try to take the lock without waiting. On failure the slot's interest remains announced.
+    bool try_acquire(bool slot)
+    {
+        if (m_held[slot] || m_head[slot]) {
+            // Somebody in this slot already holds the lock or is ahead of us in the queue.
+            return false;
+        }
+
+        m_interested[slot] = true;
+        m_thread_priority = !slot;
+        fence();
+
+        if (available(slot)) {
+            m_held[slot] = true;
+            asm volatile("" ::: "memory");
+            return true;
+        }
+
+        return false;
+    }
+
+    /// Queue a waiter which failed to take the lock.
+    void wait(bool slot, Awaiter *awaiter, std::coroutine_handle<> handle)
+    {
+        const bool first = !m_head[slot];
+
+        awaiter->m_handle = handle;
+
+        if (first) {
+            m_head[slot] = awaiter;
+        } else {
+            m_tail[slot]->m_next = awaiter;
+        }
+        m_tail[slot] = awaiter;
+
+        if (first && !m_held[slot]) {
+            // We're the one who just lost the race, so park the slot.
+            m_executor[slot] = Executor::current();
+            m_parked[slot] = true;
+            fence();
+
+            check_parked(slot);
+        }
+    }
+
+    /// Grant the lock to a parked slot if it has become available.
+    void check_parked(bool slot)
+    {
+        if (m_parked[slot] && available(slot)) {
+            m_parked[slot] = false;
+            grant(slot);
+        }
+    }
+
+    /// Give the lock to the first waiter in the slot, scheduling it on the slot's executor.
+    void grant(bool slot)
+    {
+        Awaiter *awaiter = m_head[slot];
+
+        m_head[slot] = awaiter->m_next;
+        if (!m_head[slot]) {
+            m_tail[slot] = nullptr;
+        }
+
+        m_held[slot] = true;
+        asm volatile("" ::: "memory");
+
+        Executor::current()->schedule(awaiter->m_handle);
+    }
+
+    /// Post a wakeup to the specified slot's executor if the slot is parked.
+    void wake_if_parked(bool slot)
+    {
+        if (m_parked[slot]) {
+            m_executor[slot]->post({ slot ? &on_wake<true> : &on_wake<false>, this });
+        }
+    }
+
+    /// Handle a wakeup on the woken slot's own thread.
+    template <bool slot>
+    static void on_wake(void *lock)
+    {
+        static_cast<AsyncPetersonLock *>(lock)->check_parked(slot);
+    }
+};
+
+#endif // _async_lock_h
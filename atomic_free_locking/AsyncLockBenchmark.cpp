@@ -0,0 +1,146 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+// This file requires C++20 coroutines and is built with -std=gnu++20; see the project file.
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "AsyncLock.h"
+#include "Benchmarks.h"
+#include "Executor.h"
+#include "Latency.h"
+#include "PetersonLock.h"
+
+using std::this_thread::yield;
+
+namespace {
+
+/// The number of coroutines each executor thread runs.
+const unsigned COROUTINE_COUNT = 2000;
+
+/// Work done inside and outside of the critical section, in iterations of think().
+const unsigned CRITICAL_WORK = 200;
+const unsigned OUTSIDE_WORK  = 200;
+
+/// A coroutine which spins in PetersonLock::acquire, stalling its whole executor while it waits.
+Task blocking_worker(Executor &executor,
+                     PetersonLock<__typeof__(&yield), true> &lock,
+                     bool slot,
+                     unsigned iterations,
+                     volatile unsigned &shared_value)
+{
+    for (unsigned i = 0; i < iterations; ++i) {
+        lock.acquire(slot);
+        shared_value = shared_value + 1;
+        think(CRITICAL_WORK);
+        lock.release(slot);
+
+        think(OUTSIDE_WORK);
+        co_await executor.yield();
+    }
+}
+
+/// The same coroutine, suspending instead of spinning while the lock is unavailable.
+Task async_worker(Executor &executor,
+                  AsyncPetersonLock<true> &lock,
+                  bool slot,
+                  unsigned iterations,
+                  volatile unsigned &shared_value)
+{
+    for (unsigned i = 0; i < iterations; ++i) {
+        co_await lock.acquire_async(slot);
+        shared_value = shared_value + 1;
+        think(CRITICAL_WORK);
+        lock.release(slot);
+
+        think(OUTSIDE_WORK);
+        co_await executor.yield();
+    }
+}
+
+/**
+ * Run COROUTINE_COUNT workers on each of two executor threads, one per lock slot.
+ *
+ * Returns the mean time per critical section in nanoseconds.
+ */
+template <typename Lock, typename Worker>
+double time_lock(Worker worker, unsigned iterations)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    Lock lock(&yield);
+
+    // Both executors live until both threads are done, since a late wakeup may still be posted to
+    // either of them; see AsyncPetersonLock.
+    Executor executor[2];
+    std::thread thread[2];
+    volatile unsigned shared_value = 0;
+
+    const auto start = clock::now();
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid] = std::thread([&, tid]()
+        {
+            for (unsigned i = 0; i < COROUTINE_COUNT; ++i) {
+                worker(executor[tid], lock, bool(tid), iterations, shared_value);
+            }
+
+            executor[tid].run();
+        });
+    }
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid].join();
+    }
+
+    const unsigned total = 2 * COROUTINE_COUNT * iterations;
+
+    if (shared_value != total) {
+        printf("Lock violation: shared_value = %u, expected %u\n", shared_value, total);
+    }
+
+    return std::chrono::duration<double, std::nano>(clock::now() - start).count() / total;
+}
+
+/// Give AsyncPetersonLock the same constructor as the other locks, for time_lock's benefit.
+struct AsyncLock : AsyncPetersonLock<true>
+{
+    AsyncLock(__typeof__(&yield)) {}
+};
+
+} // anonymous namespace
+
+void benchmark_async_lock(unsigned loop_count)
+{
+    const unsigned iterations = loop_count > COROUTINE_COUNT ? loop_count / COROUTINE_COUNT : 1;
+
+    printf("Time per critical section (ns), 2 threads x %u coroutines x %u iterations\n",
+           COROUTINE_COUNT, iterations);
+
+    printf("%-10s %10.1f\n", "blocking",
+           time_lock<PetersonLock<__typeof__(&yield), true>>(blocking_worker, iterations));
+    printf("%-10s %10.1f\n", "async",
+           time_lock<AsyncLock>(async_worker, iterations));
+}
@@ -0,0 +1,320 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _barrier_h
+#define _barrier_h
+
+#include <cstdint>
+#include <cassert>
+
+#include "CacheLine.h"
+
+/**
+ * A family of spinning barriers for N threads, built like PetersonLock from plain flag stores
+ * and loads; none of them uses an atomic read-modify-write instruction.
+ *
+ * Unlike PetersonLock, no mfence is required. Every flag has exactly one writer per episode and
+ * the waiter simply spins until the write shows up, so x86's store-to-load reordering can only
+ * delay a waiter, never fool it. x86 already keeps stores in order with respect to other stores
+ * and loads with respect to other loads, which is all a barrier needs to publish the data written
+ * before it. We only have to keep the compiler from moving accesses across the flag operations.
+ *
+ * All barriers use sense reversal so that they may be reused immediately: the value signalled in
+ * one episode is the inverse of the value signalled in the previous one, so a slow thread can
+ * never confuse a stale flag with a fresh one.
+ *
+ * As with PetersonLock, the function used to delay while spinning is a template parameter.
+ * Callers identify themselves with a thread number in [0, thread_count).
+ */
+
+/// Prevent the compiler from moving memory accesses across this point. Emits no instructions.
+#define BARRIER_COMPILER_FENCE() asm volatile("" ::: "memory")
+
+namespace barrier_detail
+{
+    /// Enough rounds for 2^MAX_ROUNDS threads.
+    static constexpr unsigned MAX_ROUNDS = 16;
+
+    /// The number of rounds needed for a log(n) barrier with the specified number of threads.
+    inline unsigned round_count(unsigned thread_count)
+    {
+        unsigned rounds = 0;
+
+        while ((1u << rounds) < thread_count) {
+            ++rounds;
+        }
+
+        assert(rounds <= MAX_ROUNDS);
+        return rounds;
+    }
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class Definitions
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A centralized sense-reversing barrier.
+ *
+ * The classic version has every thread decrement a shared counter, which needs an atomic RMW.
+ * Here each thread instead sets its own arrival flag, and thread 0 gathers them all before
+ * flipping the global sense which everybody else is spinning on. Cheap for small thread counts;
+ * thread 0's linear scan makes it the worst of the family for large ones.
+ */
+template <typename WaitFunction>
+class SenseReversingBarrier
+{
+    struct Slot
+    {
+        volatile bool arrived = false;
+        bool          sense   = false;
+    };
+
+    WaitFunction m_wait_function;
+    const unsigned m_thread_count;
+
+    /// Per-thread state, padded to keep threads from sharing cache lines.
+    CacheLineArray<Slot> m_slot;
+
+    /// Flipped by thread 0 once every thread has arrived.
+    volatile bool m_sense = false;
+
+public:
+    SenseReversingBarrier(unsigned thread_count, WaitFunction wait_function)
+        : m_wait_function(wait_function)
+        , m_thread_count(thread_count)
+        , m_slot(thread_count)
+    {
+        assert(thread_count > 0);
+    }
+
+    /// Wait until all threads have called wait() for the current episode.
+    void wait(unsigned thread)
+    {
+        assert(thread < m_thread_count);
+
+        Slot &slot = m_slot[thread];
+        const bool sense = slot.sense = !slot.sense;
+
+        BARRIER_COMPILER_FENCE();
+        slot.arrived = sense;
+
+        if (thread == 0) {
+            for (unsigned i = 1; i < m_thread_count; ++i) {
+                while (m_slot[i].arrived != sense) {
+                    m_wait_function();
+                }
+            }
+
+            m_sense = sense;
+        } else {
+            while (m_sense != sense) {
+                m_wait_function();
+            }
+        }
+
+        BARRIER_COMPILER_FENCE();
+    }
+};
+
+/******************************************************************************/
+
+/**
+ * A dissemination barrier (Hensgen, Finkel and Manber).
+ *
+ * In round r, thread i signals thread (i + 2^r) mod N and waits to be signalled by
+ * thread (i - 2^r) mod N. After ceil(log2(N)) rounds every thread has transitively heard from
+ * every other. There is no distinguished thread and no wakeup phase, so the critical path is
+ * short, at the cost of N*log(N) flag writes per episode.
+ *
+ * Flags alternate between two parity sets so that a thread racing ahead into the next episode
+ * cannot overwrite a flag its partner has not yet seen.
+ */
+template <typename WaitFunction>
+class DisseminationBarrier
+{
+    struct Slot
+    {
+        /// Flags written by this thread's partners, indexed by parity and round.
+        volatile bool flag[2][barrier_detail::MAX_ROUNDS];
+
+        unsigned parity = 0;
+        bool     sense  = true;
+
+        Slot()
+        {
+            for (unsigned p = 0; p < 2; ++p) {
+                for (unsigned r = 0; r < barrier_detail::MAX_ROUNDS; ++r) {
+                    flag[p][r] = false;
+                }
+            }
+        }
+    };
+
+    WaitFunction m_wait_function;
+    const unsigned m_thread_count;
+    const unsigned m_rounds;
+    CacheLineArray<Slot> m_slot;
+
+public:
+    DisseminationBarrier(unsigned thread_count, WaitFunction wait_function)
+        : m_wait_function(wait_function)
+        , m_thread_count(thread_count)
+        , m_rounds(barrier_detail::round_count(thread_count))
+        , m_slot(thread_count)
+    {
+        assert(thread_count > 0);
+    }
+
+    /// Wait until all threads have called wait() for the current episode.
+    void wait(unsigned thread)
+    {
+        assert(thread < m_thread_count);
+
+        Slot &slot = m_slot[thread];
+        const unsigned parity = slot.parity;
+        const bool sense = slot.sense;
+
+        BARRIER_COMPILER_FENCE();
+
+        for (unsigned r = 0; r < m_rounds; ++r) {
+            const unsigned partner = (thread + (1u << r)) % m_thread_count;
+
+            m_slot[partner].flag[parity][r] = sense;
+
+            while (slot.flag[parity][r] != sense) {
+                m_wait_function();
+            }
+        }
+
+        BARRIER_COMPILER_FENCE();
+
+        // Reverse the sense only after both parity sets have been used with it.
+        if (parity == 1) {
+            slot.sense = !sense;
+        }
+        slot.parity = 1 - parity;
+    }
+};
+
+/******************************************************************************/
+
+/**
+ * A tournament barrier with statically chosen winners (Mellor-Crummey and Scott).
+ *
+ * In round r, the thread whose number has bit r set (and no lower bits set) is the loser: it
+ * reports its arrival to its opponent, thread - 2^r, and spins on its own wakeup flag. The winner
+ * spins on its arrival flag, then advances. Thread 0 wins every round and so is the champion.
+ * Once it knows everybody has arrived, it wakes the losers it beat, who in turn wake the losers
+ * they beat, and so on back down the tree.
+ *
+ * Each flag has a fixed writer and a fixed reader, so a thread only ever spins on its own
+ * cache line.
+ */
+template <typename WaitFunction>
+class TournamentBarrier
+{
+    struct Slot
+    {
+        /// Written by the loser of each round this thread won.
+        volatile bool arrived[barrier_detail::MAX_ROUNDS];
+
+        /// Written by the winner of the round this thread lost.
+        volatile bool wakeup = false;
+
+        bool sense = false;
+
+        Slot()
+        {
+            for (unsigned r = 0; r < barrier_detail::MAX_ROUNDS; ++r) {
+                arrived[r] = false;
+            }
+        }
+    };
+
+    WaitFunction m_wait_function;
+    const unsigned m_thread_count;
+    const unsigned m_rounds;
+    CacheLineArray<Slot> m_slot;
+
+public:
+    TournamentBarrier(unsigned thread_count, WaitFunction wait_function)
+        : m_wait_function(wait_function)
+        , m_thread_count(thread_count)
+        , m_rounds(barrier_detail::round_count(thread_count))
+        , m_slot(thread_count)
+    {
+        assert(thread_count > 0);
+    }
+
+    /// Wait until all threads have called wait() for the current episode.
+    void wait(unsigned thread)
+    {
+        assert(thread < m_thread_count);
+
+        Slot &slot = m_slot[thread];
+        const bool sense = slot.sense = !slot.sense;
+
+        BARRIER_COMPILER_FENCE();
+
+        // Arrival: play rounds until we lose one or win them all. 'round' ends up as the number
+        // of rounds we won, which is also the number of losers we must wake.
+        unsigned round = 0;
+
+        for (; round < m_rounds; ++round) {
+            const unsigned bit = 1u << round;
+
+            if (thread & bit) {
+                m_slot[thread - bit].arrived[round] = sense;
+
+                while (slot.wakeup != sense) {
+                    m_wait_function();
+                }
+                break;
+            }
+
+            if (thread + bit < m_thread_count) {
+                while (slot.arrived[round] != sense) {
+                    m_wait_function();
+                }
+            }
+        }
+
+        // Wakeup: release the losers we beat, most senior first so that whole subtrees start
+        // waking as early as possible.
+        while (round-- > 0) {
+            const unsigned loser = thread + (1u << round);
+
+            if (loser < m_thread_count) {
+                m_slot[loser].wakeup = sense;
+            }
+        }
+
+        BARRIER_COMPILER_FENCE();
+    }
+};
+
+#undef BARRIER_COMPILER_FENCE
+
+#endif // _barrier_h
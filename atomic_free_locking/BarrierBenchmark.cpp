@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "Barrier.h"
+#include "Benchmarks.h"
+
+using std::this_thread::yield;
+using WaitFunction = __typeof__(&yield);
+
+/**
+ * Time loop_count episodes of the specified barrier type with the specified number of threads.
+ *
+ * Returns the mean episode latency in nanoseconds, as observed by thread 0.
+ */
+template <typename Barrier>
+static double time_barrier(unsigned thread_count, unsigned loop_count)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    Barrier barrier(thread_count, &yield);
+    std::vector<std::thread> thread;
+    clock::duration elapsed;
+
+    for (unsigned tid = 0; tid < thread_count; ++tid) {
+        thread.emplace_back([&, tid]()
+        {
+            // Line everybody up before starting the clock.
+            barrier.wait(tid);
+
+            const auto start = clock::now();
+
+            for (unsigned i = 0; i < loop_count; ++i) {
+                barrier.wait(tid);
+            }
+
+            if (tid == 0) {
+                elapsed = clock::now() - start;
+            }
+        });
+    }
+
+    for (auto &t : thread) {
+        t.join();
+    }
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / loop_count;
+}
+
+void benchmark_barriers(unsigned loop_count)
+{
+    printf("Barrier episode latency (ns), %u episodes per configuration\n", loop_count);
+    printf("%8s %16s %16s %16s\n", "threads", "sense-reversing", "dissemination", "tournament");
+
+    for (unsigned thread_count = 2; thread_count <= 64; thread_count *= 2) {
+        printf("%8u %16.1f %16.1f %16.1f\n",
+               thread_count,
+               time_barrier<SenseReversingBarrier<WaitFunction>>(thread_count, loop_count),
+               time_barrier<DisseminationBarrier<WaitFunction>>(thread_count, loop_count),
+               time_barrier<TournamentBarrier<WaitFunction>>(thread_count, loop_count));
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _benchmarks_h
+#define _benchmarks_h
+
+/**
+ * Entry points for the benchmarks main() can run in place of the default lock exercise.
+ *
+ * Each takes the loop count passed on the command line and interprets it as the number of
+ * iterations to run per measured configuration.
+ */
+
+/// Measure barrier episode latency for each barrier type from 2 to 64 threads.
+void benchmark_barriers(unsigned loop_count);
+
+/// Compare the adaptive lock against fixed spinning and parking locks across changing contention.
+void benchmark_adaptive_lock(unsigned loop_count);
+
+/// Measure how each lock's throughput and tail latency degrade next to each kind of noisy neighbor.
+void benchmark_interference(unsigned loop_count);
+
+/// Measure the cost of the USDT probes with no tracer attached.
+void benchmark_probes(unsigned loop_count);
+
+/// Compare coroutine-awaitable acquisition with blocking acquisition on event loop threads.
+void benchmark_async_lock(unsigned loop_count);
+
+/// Measure per-class acquire latency of the priority-aware lock against the plain PetersonLock.
+void benchmark_priority(unsigned loop_count);
+
+/// Demonstrate LockSampler's estimates on a workload with lopsided critical sections.
+void benchmark_sampler(unsigned loop_count);
+
+/// Compare leased acquisition, which keeps the lock until the other thread wants it, with plain
+/// acquire/release.
+void benchmark_lease(unsigned loop_count);
+
+/// Compare the reader-side cost and memory held by epoch-based reclamation, with symmetric and
+/// asymmetric fences, against freeing under a lock.
+void benchmark_epoch(unsigned loop_count);
+
+/// Re-measure this machine's calibration profile, print it beside the cached one, and save it.
+void benchmark_calibration(unsigned loop_count);
+
+#endif // _benchmarks_h
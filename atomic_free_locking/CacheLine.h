@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _cache_line_h
+#define _cache_line_h
+
+#include <cstdlib>
+#include <new>
+
+/// The cache line size of every x86 CPU this code is meant for.
+static constexpr unsigned CACHE_LINE_SIZE = 64;
+
+/**
+ * A per-thread structure padded and aligned to a whole number of cache lines, so that threads
+ * writing neighboring elements of an array never share a line.
+ */
+template <typename T>
+struct alignas(CACHE_LINE_SIZE) CacheLinePadded : T
+{};
+
+/**
+ * A fixed-size heap array of CacheLinePadded<T>.
+ *
+ * Under C++14, operator new only guarantees 16 byte alignment, which would let an element
+ * straddle two lines, so the storage comes from posix_memalign instead.
+ */
+template <typename T>
+class CacheLineArray
+{
+    CacheLinePadded<T> *m_element = nullptr;
+    unsigned m_count = 0;
+
+public:
+    explicit CacheLineArray(unsigned count)
+        : m_count(count)
+    {
+        void *storage = nullptr;
+
+        if (posix_memalign(&storage, CACHE_LINE_SIZE, count * sizeof(CacheLinePadded<T>)) != 0) {
+            throw std::bad_alloc();
+        }
+
+        m_element = static_cast<CacheLinePadded<T> *>(storage);
+
+        for (unsigned i = 0; i < count; ++i) {
+            new (&m_element[i]) CacheLinePadded<T>;
+        }
+    }
+
+    ~CacheLineArray()
+    {
+        for (unsigned i = 0; i < m_count; ++i) {
+            m_element[i].~CacheLinePadded<T>();
+        }
+
+        free(m_element);
+    }
+
+    CacheLineArray(const CacheLineArray&) = delete;
+    CacheLineArray &operator=(const CacheLineArray&) = delete;
+
+    CacheLinePadded<T>       &operator[](unsigned i)       { return m_element[i]; }
+    const CacheLinePadded<T> &operator[](unsigned i) const { return m_element[i]; }
+};
+
+#endif // _cache_line_h
@@ -0,0 +1,238 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <mach/mach_time.h>
+#include <sys/sysctl.h>
+#include <x86intrin.h>
+
+#include "Calibration.h"
+
+namespace {
+
+/// Each cost is measured this many times, keeping the cheapest, to filter out interruptions.
+constexpr unsigned MEASUREMENT_ROUNDS = 8;
+
+/// Read an integer sysctl, or return the specified default if it is unavailable.
+uint64_t sysctl_integer(const char *name, uint64_t default_value)
+{
+    int64_t value = 0;
+    size_t length = sizeof(value);
+
+    if (sysctlbyname(name, &value, &length, nullptr, 0) != 0) {
+        return default_value;
+    }
+
+    // Some of these sysctls are 32 bits wide.
+    return length == sizeof(int32_t) ? uint64_t(int32_t(value)) : uint64_t(value);
+}
+
+/// The path of the cached profile, or an empty string if there is nowhere to keep it.
+std::string cache_path()
+{
+    const char *home = getenv("HOME");
+
+    return home ? std::string(home) + "/Library/Caches/atomic_free_locking.calibration" : "";
+}
+
+/// Time the specified operation, returning the cost of one repetition in nanoseconds.
+template <typename Operation>
+double time_operation(unsigned repetitions, double ns_per_tick, Operation operation)
+{
+    double best = 0;
+
+    for (unsigned round = 0; round < MEASUREMENT_ROUNDS; ++round) {
+        const uint64_t start = mach_absolute_time();
+
+        for (unsigned i = 0; i < repetitions; ++i) {
+            operation();
+        }
+
+        const double cost = (mach_absolute_time() - start) * ns_per_tick / repetitions;
+
+        if (round == 0 || cost < best) {
+            best = cost;
+        }
+    }
+
+    return best;
+}
+
+bool load(Calibration &profile)
+{
+    const std::string path = cache_path();
+    FILE *file = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+
+    if (!file) {
+        return false;
+    }
+
+    // Read one byte past the profile, to reject a file of the wrong size.
+    char extra;
+    const bool loaded = fread(&profile, sizeof(profile), 1, file) == 1 &&
+                        fread(&extra, 1, 1, file) == 0;
+    fclose(file);
+
+    profile.cpu_model[sizeof(profile.cpu_model) - 1] = '\0';
+
+    return loaded;
+}
+
+} // anonymous namespace
+
+Calibration
+Calibration::identify()
+{
+    Calibration machine;
+    size_t length = sizeof(machine.cpu_model);
+
+    if (sysctlbyname("machdep.cpu.brand_string", machine.cpu_model, &length, nullptr, 0) != 0) {
+        strncpy(machine.cpu_model, "unknown", sizeof(machine.cpu_model) - 1);
+    }
+
+    machine.microcode       = sysctl_integer("machdep.cpu.microcode_version", 0);
+    machine.logical_cpus    = uint32_t(sysctl_integer("hw.logicalcpu", std::thread::hardware_concurrency()));
+    machine.physical_cpus   = uint32_t(sysctl_integer("hw.physicalcpu", machine.logical_cpus));
+    machine.cache_line_size = uint32_t(sysctl_integer("hw.cachelinesize", 64));
+    machine.llc_size        = sysctl_integer("hw.l3cachesize", sysctl_integer("hw.l2cachesize", 8u << 20));
+
+    return machine;
+}
+
+Calibration
+Calibration::measure()
+{
+    Calibration machine = identify();
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    machine.ns_per_tick = double(timebase.numer) / timebase.denom;
+
+    // Compare the TSC with the system clock across a busy wait of about 10ms.
+    const uint64_t interval = uint64_t(10'000'000 / machine.ns_per_tick);
+    const uint64_t start_ticks = mach_absolute_time();
+    const uint64_t start_cycles = __rdtsc();
+    uint64_t ticks;
+
+    while ((ticks = mach_absolute_time() - start_ticks) < interval) {}
+
+    machine.cycles_per_tick = double(__rdtsc() - start_cycles) / ticks;
+
+    machine.pause_ns = time_operation(10'000, machine.ns_per_tick, []()
+    {
+        asm volatile("pause" ::: "memory");
+    });
+
+    machine.yield_ns = time_operation(1'000, machine.ns_per_tick, []()
+    {
+        std::this_thread::yield();
+    });
+
+    machine.sleep_ns = time_operation(4, machine.ns_per_tick, []()
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(1));
+    });
+
+    machine.spin_budget = uint32_t(std::max(1.0, machine.yield_ns / machine.pause_ns));
+
+    return machine;
+}
+
+void
+Calibration::save() const
+{
+    const std::string path = cache_path();
+
+    if (path.empty()) {
+        return;
+    }
+
+    // Each process writes its own temporary file, and rename() replaces the cache atomically.
+    const std::string temporary = path + "." + std::to_string(getpid());
+    FILE *file = fopen(temporary.c_str(), "wb");
+
+    // Not being able to cache the profile only costs the next run a re-measurement.
+    if (!file) {
+        return;
+    }
+
+    const bool written = fwrite(this, sizeof(*this), 1, file) == 1;
+
+    if (fclose(file) == 0 && written) {
+        rename(temporary.c_str(), path.c_str());
+    } else {
+        remove(temporary.c_str());
+    }
+}
+
+bool
+Calibration::matches(const Calibration &machine) const
+{
+    return version == VERSION &&
+           strncmp(cpu_model, machine.cpu_model, sizeof(cpu_model)) == 0 &&
+           microcode == machine.microcode &&
+           logical_cpus == machine.logical_cpus &&
+           physical_cpus == machine.physical_cpus &&
+           cache_line_size == machine.cache_line_size &&
+           llc_size == machine.llc_size;
+}
+
+void
+Calibration::print() const
+{
+    printf("CPU:         %s (microcode 0x%llx)\n", cpu_model, (unsigned long long)microcode);
+    printf("Topology:    %u logical CPUs, %u physical, %u byte cache lines, %llu KB LLC\n",
+           logical_cpus, physical_cpus, cache_line_size, (unsigned long long)llc_size >> 10);
+    printf("Clocks:      %.3f ns, %.3f TSC cycles per tick\n", ns_per_tick, cycles_per_tick);
+    printf("pause:       %8.2f ns\n", pause_ns);
+    printf("yield:       %8.2f ns\n", yield_ns);
+    printf("sleep:       %8.0f ns\n", sleep_ns);
+    printf("Spin budget: %u pauses\n", spin_budget);
+}
+
+const Calibration &
+calibration()
+{
+    static const Calibration profile = []()
+    {
+        Calibration cached;
+
+        if (load(cached) && cached.matches(Calibration::identify())) {
+            return cached;
+        }
+
+        const Calibration measured = Calibration::measure();
+        measured.save();
+
+        return measured;
+    }();
+
+    return profile;
+}
@@ -0,0 +1,106 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _calibration_h
+#define _calibration_h
+
+#include <cstdint>
+
+/**
+ * Machine-specific constants, measured once and cached on disk.
+ *
+ * Measuring clock rates and instruction costs takes tens of milliseconds, which would dwarf a short
+ * benchmark run, and the results only change with the hardware. The profile is therefore cached,
+ * keyed by CPU model and microcode revision, and re-measured whenever either no longer matches the
+ * running machine (or the profile layout changes).
+ *
+ * The profile is a plain struct so that loading it is a single read. It is saved by writing a
+ * temporary file and renaming it over the cache, so a reader never sees a partial profile.
+ */
+struct Calibration
+{
+    /// Bump whenever the layout or meaning of any field changes.
+    static constexpr uint32_t VERSION = 3;
+
+    uint32_t version = VERSION;
+
+    /// @name Hardware identity
+    /// @{
+    char     cpu_model[128] = {};       ///< machdep.cpu.brand_string
+    uint64_t microcode = 0;             ///< machdep.cpu.microcode_version
+    /// @}
+
+    /// @name Clocks
+    /// @{
+    double ns_per_tick = 1;             ///< Nanoseconds per mach_absolute_time tick.
+    double cycles_per_tick = 1;         ///< TSC cycles per mach_absolute_time tick.
+    /// @}
+
+    /// @name Costs, in nanoseconds
+    /// @{
+    double pause_ns = 0;                ///< One pause instruction, i.e. one iteration of a spin.
+    double yield_ns = 0;                ///< One std::this_thread::yield with nothing else to run.
+    double sleep_ns = 0;                ///< The shortest sleep the scheduler will actually deliver.
+    /// @}
+
+    /// The number of pauses costing as much as one yield; longer spins should yield instead. Used
+    /// by AdaptiveLock to bound its spinning before it acquires.
+    uint32_t spin_budget = 1;
+
+    /// @name Topology
+    /// @{
+    uint32_t logical_cpus = 1;
+    uint32_t physical_cpus = 1;
+    uint32_t cache_line_size = 64;
+    uint64_t llc_size = 8u << 20;       ///< Last level cache size in bytes.
+    /// @}
+
+    /// Read the running machine's identity and topology, leaving everything else at its default.
+    static Calibration identify();
+
+    /// Identify and measure the running machine.
+    static Calibration measure();
+
+    /**
+     * Whether this profile was measured on the specified machine, as returned by identify(), with
+     * the current layout. Compares the topology as well as the CPU, since a profile may be copied
+     * to a machine with the same CPU model but a different core count or cache.
+     */
+    bool matches(const Calibration &machine) const;
+
+    /// Replace the cached profile with this one.
+    void save() const;
+
+    /// Print the profile to stdout.
+    void print() const;
+};
+
+/**
+ * The running machine's calibration profile.
+ *
+ * The first call loads the cached profile, re-measuring and saving it if it is missing or stale.
+ * Later calls are free.
+ */
+const Calibration &calibration();
+
+#endif // _calibration_h
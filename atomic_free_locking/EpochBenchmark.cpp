@@ -0,0 +1,242 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <thread>
+#include <mach/mach_time.h>
+
+#include "Barrier.h"
+#include "Benchmarks.h"
+#include "EpochReclaimer.h"
+#include "Latency.h"
+#include "PetersonLock.h"
+
+using std::this_thread::yield;
+using WaitFunction = __typeof__(&yield);
+
+namespace {
+
+/// Retired objects are collected once per this many updates.
+const unsigned COLLECT_INTERVAL = 64;
+
+/// Work done by the writer between updates, in iterations of think().
+const unsigned UPDATE_WORK = 200;
+
+/// The shared object. Its words all hold the same value, unless it has been freed.
+struct Node
+{
+    static constexpr uint64_t POISON = 0xdeaddeaddeaddeadull;
+
+    volatile uint64_t value[8];
+
+    explicit Node(uint64_t v)
+    {
+        for (auto &word : value) {
+            word = v;
+        }
+    }
+
+    ~Node()
+    {
+        for (auto &word : value) {
+            word = POISON;
+        }
+    }
+
+    /// Whether the node still looks alive. A freed node may also be reused, hence the comparison.
+    bool valid() const
+    {
+        for (const auto &word : value) {
+            if (word != value[0] || word == POISON) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+struct Result
+{
+    double   read_ns;       ///< Mean cost of one read-side critical section.
+    double   mean_held;     ///< Mean number of objects unlinked but not yet freed.
+    size_t   max_held;      ///< Maximum number of objects unlinked but not yet freed.
+    unsigned errors;        ///< Reads which saw a freed node.
+};
+
+/**
+ * Run one reader thread, calling read() until the writer thread has called update() loop_count
+ * times.
+ *
+ * read() returns whether the node it read was valid. update() replaces the shared node and
+ * returns the number of objects unlinked but not yet freed.
+ */
+template <typename Read, typename Update>
+Result run(unsigned loop_count, Read read, Update update)
+{
+    SenseReversingBarrier<WaitFunction> barrier(2, &yield);
+    volatile bool done = false;
+    Result result = {};
+
+    std::thread reader([&]()
+    {
+        uint64_t reads = 0;
+
+        barrier.wait(0);
+        const uint64_t start_time = mach_absolute_time();
+
+        while (!done) {
+            if (!read()) {
+                ++result.errors;
+            }
+            ++reads;
+        }
+
+        result.read_ns = ticks_to_ns(mach_absolute_time() - start_time) / reads;
+    });
+
+    std::thread writer([&]()
+    {
+        double total_held = 0;
+
+        barrier.wait(1);
+
+        for (unsigned i = 0; i < loop_count; ++i) {
+            const size_t held = update(i);
+
+            total_held += held;
+            if (held > result.max_held) {
+                result.max_held = held;
+            }
+
+            think(UPDATE_WORK);
+        }
+
+        result.mean_held = total_held / loop_count;
+        done = true;
+    });
+
+    reader.join();
+    writer.join();
+
+    return result;
+}
+
+/// The reader looks up the node under a PetersonLock, and the writer frees nodes under it.
+Result time_locked(unsigned loop_count)
+{
+    PetersonLock<WaitFunction, true> lock(&yield);
+    Node *volatile shared = new Node(0);
+
+    Result result = run(loop_count, [&]()
+    {
+        lock.acquire(0);
+        const bool valid = shared->valid();
+        lock.release(0);
+
+        return valid;
+    },
+    [&](unsigned i) -> size_t
+    {
+        Node *node = new Node(i + 1);
+
+        lock.acquire(1);
+        Node *old = shared;
+        shared = node;
+        delete old;
+        lock.release(1);
+
+        return 0;
+    });
+
+    delete shared;
+
+    return result;
+}
+
+/// The reader looks up the node in an epoch, and the writer retires nodes to the reclaimer.
+template <typename Fence>
+Result time_epoch(unsigned loop_count)
+{
+    Node *volatile shared = new Node(0);
+    Result result;
+
+    {
+        EpochReclaimer<Fence> reclaimer(1);
+
+        result = run(loop_count, [&]()
+        {
+            reclaimer.enter(0);
+            const bool valid = shared->valid();
+            reclaimer.exit(0);
+
+            return valid;
+        },
+        [&](unsigned i)
+        {
+            Node *old = shared;
+            shared = new Node(i + 1);
+            reclaimer.retire(old);
+
+            if ((i + 1) % COLLECT_INTERVAL == 0) {
+                reclaimer.collect();
+            }
+
+            return reclaimer.retired_count();
+        });
+    }
+
+    delete shared;
+
+    return result;
+}
+
+void print_result(const char *name, const Result &result)
+{
+    printf("%-16s %10.2f %12.1f %12zu %12.0f %8u\n",
+           name,
+           result.read_ns,
+           result.mean_held,
+           result.max_held,
+           result.max_held * sizeof(Node) / 1024.0,
+           result.errors);
+}
+
+} // anonymous namespace
+
+void benchmark_epoch(unsigned loop_count)
+{
+    printf("Epoch-based reclamation vs. freeing under a lock, %u updates, collecting every %u\n",
+           loop_count, COLLECT_INTERVAL);
+    printf("%-16s %10s %12s %12s %12s %8s\n",
+           "reclamation", "read (ns)", "mean held", "max held", "max KB held", "errors");
+
+    print_result("locked", time_locked(loop_count));
+    print_result("epoch", time_epoch<SymmetricFence>(loop_count));
+
+    if (AsymmetricFence::available()) {
+        print_result("epoch asymmetric", time_epoch<AsymmetricFence>(loop_count));
+    } else {
+        printf("%-16s unavailable\n", "epoch asymmetric");
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdlib>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if __has_include(<linux/membarrier.h>)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#define HAVE_MEMBARRIER 1
+#endif
+
+#include "EpochReclaimer.h"
+
+namespace {
+
+/// How the process-wide barrier is issued.
+enum class Method
+{
+    NONE,
+    MEMBARRIER,     ///< membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+    MPROTECT,       ///< Downgrading the protection of a dirty, locked page.
+};
+
+Method g_method = Method::NONE;
+void *g_page = nullptr;
+std::mutex g_page_mutex;
+
+Method setup()
+{
+#if HAVE_MEMBARRIER
+    const long commands = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+
+    if (commands > 0 &&
+        (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+        syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+    {
+        return Method::MEMBARRIER;
+    }
+#endif
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    g_page = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+    if (g_page == MAP_FAILED) {
+        g_page = nullptr;
+        return Method::NONE;
+    }
+
+    // The page must stay resident, or there would be no mapping to shoot down.
+    if (mlock(g_page, page_size) != 0) {
+        munmap(g_page, page_size);
+        g_page = nullptr;
+        return Method::NONE;
+    }
+
+    return Method::MPROTECT;
+}
+
+} // anonymous namespace
+
+bool
+AsymmetricFence::available()
+{
+    static const bool available = []()
+    {
+        g_method = setup();
+        return g_method != Method::NONE;
+    }();
+
+    return available;
+}
+
+void
+AsymmetricFence::reclaimer()
+{
+    switch (g_method) {
+    case Method::MEMBARRIER:
+#if HAVE_MEMBARRIER
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+#endif
+        break;
+
+    case Method::MPROTECT: {
+        std::lock_guard<std::mutex> guard(g_page_mutex);
+        const long page_size = sysconf(_SC_PAGESIZE);
+
+        // Dirtying the page and then write protecting it forces the kernel to flush it from the
+        // TLB of every CPU running one of our threads, interrupting them.
+        *static_cast<volatile char *>(g_page) = 1;
+        mprotect(g_page, page_size, PROT_READ);
+        mprotect(g_page, page_size, PROT_READ | PROT_WRITE);
+        break;
+    }
+
+    case Method::NONE:
+        // available() must have returned true before the fence is used.
+        abort();
+    }
+
+    asm volatile("mfence" ::: "memory");
+}
@@ -0,0 +1,210 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _epoch_reclaimer_h
+#define _epoch_reclaimer_h
+
+#include <cstdint>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+#include "CacheLine.h"
+
+/**
+ * How readers and the reclaimer order their announcements against their subsequent loads.
+ *
+ * Both sides of the epoch protocol store a flag and then load the other side's, which x86 may
+ * reorder, exactly as in PetersonLock. SymmetricFence puts an mfence on both sides.
+ */
+struct SymmetricFence
+{
+    static bool available() { return true; }
+    static void reader() { asm volatile("mfence" ::: "memory"); }
+    static void reclaimer() { asm volatile("mfence" ::: "memory"); }
+};
+
+/**
+ * Moves the whole cost of the fence to the reclaimer, which issues a process-wide barrier that
+ * interrupts every running thread of the process, serializing it as an mfence would. Readers are
+ * left with a compiler barrier.
+ *
+ * Uses membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED) where the kernel has it, and otherwise
+ * changes the protection of a locked page, whose TLB shootdown has the same effect.
+ */
+struct AsymmetricFence
+{
+    /// Whether a process-wide barrier could be set up. Sets it up on first call; EpochReclaimer
+    /// calls it on construction, so reclaimer() is never reached without a barrier.
+    static bool available();
+
+    static void reader() { asm volatile("" ::: "memory"); }
+    static void reclaimer();
+};
+
+/**
+ * Epoch-based reclamation of memory shared by any number of readers and one reclaimer thread,
+ * without atomic read-modify-write instructions.
+ *
+ * Readers bracket their accesses with enter() and exit(). The reclaimer unlinks objects, hands
+ * them to retire(), and frees them in collect() once no reader can still be using them.
+ *
+ * Like PetersonLock, the protocol consists of flags each written by only one thread:
+ * - The global epoch is only written by the reclaimer.
+ * - Each reader announces, in a slot only it writes, the epoch it entered in, or QUIESCENT.
+ *
+ * A reader stores its announcement and then loads shared pointers; the reclaimer stores its
+ * unlinks and a new epoch and then loads the announcements. With a fence on each side (see the
+ * Fence policies), at least one of them sees the other's store: either the reader sees the
+ * unlink, or the reclaimer sees the reader was active in an epoch in which the object was still
+ * reachable, and keeps the object.
+ */
+template <typename Fence = SymmetricFence>
+class EpochReclaimer
+{
+    using epoch_t = uint64_t;
+
+    /// A reader's announcement when it is outside of a read-side critical section.
+    static constexpr epoch_t QUIESCENT = 0;
+
+    /// A reader's announcement. Kept alone on its cache line by CacheLineArray.
+    struct Slot
+    {
+        volatile epoch_t epoch;
+    };
+
+    /// An object awaiting reclamation.
+    struct Retired
+    {
+        void *object;
+        void (*deleter)(void *);
+        epoch_t epoch;      ///< The epoch in which the object was unlinked.
+    };
+
+    const unsigned m_reader_count;
+    CacheLineArray<Slot> m_slot;
+
+    /// The current epoch. Only written by the reclaimer.
+    volatile epoch_t m_epoch = 1;
+
+    /// Objects retired but not yet freed, oldest first. Only accessed by the reclaimer.
+    std::vector<Retired> m_retired;
+
+public:
+    /// Sets up the Fence policy, throwing std::runtime_error if it is unavailable on this machine.
+    explicit EpochReclaimer(unsigned reader_count)
+        : m_reader_count(reader_count)
+        , m_slot(reader_count)
+    {
+        if (!Fence::available()) {
+            throw std::runtime_error("EpochReclaimer: fence policy unavailable");
+        }
+
+        for (unsigned reader = 0; reader < reader_count; ++reader) {
+            m_slot[reader].epoch = QUIESCENT;
+        }
+    }
+
+    /// Free everything still retired. No reader may be active.
+    ~EpochReclaimer()
+    {
+        for (const Retired &retired : m_retired) {
+            retired.deleter(retired.object);
+        }
+    }
+
+    /// Begin a read-side critical section for the specified reader.
+    void enter(unsigned reader)
+    {
+        assert(m_slot[reader].epoch == QUIESCENT);
+
+        m_slot[reader].epoch = m_epoch;
+
+        // The announcement must be visible before any shared pointer is loaded.
+        Fence::reader();
+    }
+
+    /// End the specified reader's read-side critical section.
+    void exit(unsigned reader)
+    {
+        // x86 doesn't reorder loads with later stores, so this only needs to stop the compiler.
+        asm volatile("" ::: "memory");
+
+        m_slot[reader].epoch = QUIESCENT;
+    }
+
+    /**
+     * Hand an object, already unlinked from the shared structure, over for reclamation.
+     * Reclaimer thread only.
+     */
+    template <typename T>
+    void retire(T *object)
+    {
+        m_retired.push_back(Retired{ object, [](void *p) { delete static_cast<T *>(p); }, m_epoch });
+    }
+
+    /**
+     * Start a new epoch and free every retired object which no reader can still be using.
+     * Reclaimer thread only. Never waits for readers.
+     *
+     * Returns the number of objects freed.
+     */
+    size_t collect()
+    {
+        // Objects unlinked before this store can't be reached by readers which enter after it.
+        // x86 keeps stores in order, so only the compiler needs stopping.
+        asm volatile("" ::: "memory");
+        m_epoch = m_epoch + 1;
+
+        // The unlinks and the new epoch must be visible before the announcements are loaded.
+        Fence::reclaimer();
+
+        // A reader active since before the new epoch may hold anything retired in its epoch or
+        // later.
+        epoch_t oldest_active = m_epoch;
+
+        for (unsigned reader = 0; reader < m_reader_count; ++reader) {
+            const epoch_t epoch = m_slot[reader].epoch;
+
+            if (epoch != QUIESCENT && epoch < oldest_active) {
+                oldest_active = epoch;
+            }
+        }
+
+        size_t freed = 0;
+
+        while (freed < m_retired.size() && m_retired[freed].epoch < oldest_active) {
+            m_retired[freed].deleter(m_retired[freed].object);
+            ++freed;
+        }
+
+        m_retired.erase(m_retired.begin(), m_retired.begin() + freed);
+
+        return freed;
+    }
+
+    /// The number of objects retired but not yet freed. Reclaimer thread only.
+    size_t retired_count() const { return m_retired.size(); }
+};
+
+#endif // _epoch_reclaimer_h
@@ -31,48 +31,50 @@ EventBuffer::dump(unsigned id, Event::timestamp_t start_time, uint32_t count) co
     unsigned n = 0;
 
     for (ConstReverseIterator current = rbegin(); current != end && n < count; ++current, ++n) {
-        current->print(id, start_time);
+        current->print(id, start_time, current.payload());
     }
 }
 
-EventBuffer::ConstReverseIterator
-EventBuffer::rend() const
+const Event &
+EventBuffer::peek() const
 {
-    // Special case for an empty EventBuffer.
-    if (!peek())
-    {
-        // Return an incremented iterator to m_current so that it compares equal to rbegin().
-        // Recall that m_current + 1 is one *before* rbegin() in a reverse iteration.
-        unsigned initial = m_current + 1;
+    const Event *newest = &m_event[0][m_current[0]];
 
-        if (initial == BUFFER_SIZE) {
-            initial = 0;
-        }
-
-        ConstReverseIterator itor(this, initial);
-        ++itor;
+    for (uint32_t tier = 1; tier < TIER_COUNT; ++tier) {
+        const Event &event = m_event[tier][m_current[tier]];
 
-        return itor;
+        if (event && (!*newest || event.logical_time > newest->logical_time)) {
+            newest = &event;
+        }
     }
 
-    // Seek the oldest entry. m_current denotes the newest, m_current-1 the second newest, etc. So
-    // the first existing entry following m_current is the oldest.
-    uint32_t next = m_current;
-
-    do {
-        next = increment(next, 1);
-    } while (!peek(next));
-
-    // We found the oldest; now go back one to get an iterator to one past the oldest in a
-    // reverse iteration.
-    return ConstReverseIterator(this, increment(next, -1));
+    return *newest;
 }
 
 void
-Event::print(unsigned id, timestamp_t start_time) const
+Event::print(unsigned id, timestamp_t start_time, const char *payload) const
 {
+    if (this->has_payload) {
+        static const char overwritten[] = "<payload overwritten>";
+
+        const int length = payload ? this->payload_length : int(sizeof(overwritten) - 1);
+
+        printf(this->fmt,
+               this->timestamp - start_time,
+               this->logical_time,
+               id,
+               this->line,
+               length,
+               payload ? payload : overwritten,
+               this->arg0,
+               this->arg1,
+               this->arg2);
+        return;
+    }
+
     printf(this->fmt,
            this->timestamp - start_time,
+           this->logical_time,
            id,
            this->line,
            this->arg0,
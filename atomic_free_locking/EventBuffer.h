@@ -24,12 +24,34 @@
 #ifndef _event_buffer_h
 #define _event_buffer_h
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <mach/mach_time.h>
 
+#include "Probes.h"
+
 /// Log an Event for later examination. See Event::print for how format arguments are passed.
 #define LOG(buf, fmt, args...) \
-    (buf).push({ "%6llu: [%3u] line %3u: " fmt "\n", mach_absolute_time(), __LINE__, ##args })
+    (buf).push({ "%6llu (%6llu): [%3u] line %3u: " fmt "\n", mach_absolute_time(), __LINE__, ##args })
+
+/**
+ * Log a rare but important Event, such as a state change or a warning, which should survive long
+ * after a hot loop has overwritten the Events around it. See EventBuffer::Tier.
+ */
+#define LOG_RARE(buf, fmt, args...) \
+    (buf).push({ "%6llu (%6llu): [%3u] line %3u: " fmt "\n", mach_absolute_time(), __LINE__, ##args }, \
+               EventBuffer::RARE)
+
+/**
+ * Log an Event carrying a copy of a short payload, such as a message key or a symbol name, which
+ * is printed as a string at the start of the message. Payloads longer than
+ * EventBuffer::MAX_PAYLOAD_SIZE are truncated.
+ */
+#define LOG_PAYLOAD(buf, data, length, fmt, args...) \
+    (buf).push({ "%6llu (%6llu): [%3u] line %3u: %.*s" fmt "\n", mach_absolute_time(), __LINE__, ##args }, \
+               (data), (length))
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Class Definitions
@@ -44,6 +66,7 @@ class Event
 {
 public:
     typedef uint64_t timestamp_t;
+    typedef uint64_t logical_time_t;
 
     // NOTE: All fields save 'fmt' are left uninitialized for performance. We alway
     // check 'fmt' before accessing other fields, and we always set all fields which
@@ -56,17 +79,28 @@ public:
     int64_t      arg1;
     int64_t      arg2;
 
+    /// Lamport clock of the logging thread. Set by EventBuffer::push, so LOG needn't supply it.
+    logical_time_t logical_time;
+
+    /// Position and size of the payload in the EventBuffer's arena. Set by EventBuffer::push.
+    uint32_t     payload_offset;
+    uint16_t     payload_length;
+    bool         has_payload;
+
     explicit operator bool() const { return !!this->fmt; }
 
     /**
      * Print this Event to stdout, marking it with the specified id number.
      *
      * The start_time parameter is subtracted from this Event's timestamp to provide an easy to
-     * read elapsed time.
+     * read elapsed time. Events logged with LOG_PAYLOAD must be passed their payload; see
+     * EventBuffer::payload.
      *
      * Disallow inlining to facilitate use in debugger
      */
-    void print(unsigned id, timestamp_t start_time) const __attribute__((noinline));
+    void print(unsigned id,
+               timestamp_t start_time,
+               const char *payload = nullptr) const __attribute__((noinline));
 };
 
 /******************************************************************************/
@@ -75,9 +109,26 @@ public:
  * A simple circular buffer for events in a specified thread.
  *
  * Intended to be used by a single thread for log overhead logging.
+ *
+ * Events are kept in one circular buffer per retention tier, so that a burst of hot loop logging
+ * only overwrites older hot loop logging. Iterators and dump() merge the tiers transparently,
+ * newest first, using the Lamport clock every push advances.
  */
 class EventBuffer
 {
+public:
+    /// The longest payload LOG_PAYLOAD will copy.
+    static constexpr uint32_t MAX_PAYLOAD_SIZE = 64u;
+
+    /// Retention tiers, each with its own circular buffer.
+    enum Tier : uint32_t
+    {
+        HOT,        ///< Frequent events, e.g. from a hot loop. The default.
+        RARE,       ///< Infrequent, important events, e.g. state changes and warnings.
+        TIER_COUNT
+    };
+
+private:
     static constexpr uint32_t BUFFER_SIZE = 256u;
     static constexpr uint32_t BUFFER_SIZE_MASK = BUFFER_SIZE - 1;
 
@@ -85,8 +136,28 @@ class EventBuffer
     static_assert((BUFFER_SIZE & BUFFER_SIZE_MASK) == 0,
                   "BUFFER_SIZE must be a power of 2 for push() to work");
 
-    uint32_t m_current = BUFFER_SIZE - 1;
-    Event m_event[BUFFER_SIZE];
+    /// Each tier's newest slot. Starts on the last slot so the first push lands on slot zero.
+    uint32_t m_current[TIER_COUNT];
+    Event m_event[TIER_COUNT][BUFFER_SIZE];
+
+    /// The owning thread's Lamport clock. Advanced by every push.
+    Event::logical_time_t m_logical_time = 0;
+
+    /**
+     * A circular bump allocator for payloads, sized for an average of 32 bytes per event so that
+     * payloads typically live as long as their events. It needs no explicit reclamation: like the
+     * events, old payloads are simply overwritten, and an Event whose payload has been
+     * overwritten is detected by its offset falling more than ARENA_SIZE behind m_arena_head.
+     */
+    static constexpr uint32_t ARENA_SIZE = BUFFER_SIZE * 32u;
+    static constexpr uint32_t ARENA_SIZE_MASK = ARENA_SIZE - 1;
+
+    static_assert((ARENA_SIZE & ARENA_SIZE_MASK) == 0, "ARENA_SIZE must be a power of 2");
+    static_assert(MAX_PAYLOAD_SIZE <= ARENA_SIZE, "MAX_PAYLOAD_SIZE must fit in the arena");
+
+    /// The arena offset at which to copy the next payload. Increases without wrapping.
+    uint32_t m_arena_head = 0;
+    char m_arena[ARENA_SIZE];
 
 private:
     static uint32_t increment(uint32_t value, int direction)
@@ -96,55 +167,157 @@ private:
         return (value + direction) & BUFFER_SIZE_MASK;
     }
 
+    /// The number of Events held in the specified tier.
+    uint32_t size(Tier tier) const
+    {
+        const uint32_t current = m_current[tier];
+
+        if (!m_event[tier][current]) {
+            return 0;
+        }
+
+        // Slots are filled in order from zero, so if the slot after the newest is in use the
+        // buffer has wrapped and is full.
+        return m_event[tier][increment(current, 1)] ? BUFFER_SIZE : current + 1;
+    }
+
 public:
+    /**
+     * Iterates over the Events of all tiers, merged newest first.
+     *
+     * Keeps a position and a count of remaining Events for each tier, and at each step yields
+     * the tier whose next Event has the greatest logical time. Exhausted iterators compare equal.
+     */
     class ConstReverseIterator
     {
     public:
         ConstReverseIterator() = default;
-        ConstReverseIterator(const EventBuffer* event_buffer, uint32_t index)
-            : m_event_buffer(event_buffer)
-            , m_current(index)
-        {}
+        explicit ConstReverseIterator(const EventBuffer* event_buffer);
 
-        const Event* operator->() const { return &m_event_buffer->peek(m_current); }
-        const Event& operator*()  const { return m_event_buffer->peek(m_current); }
+        const Event* operator->() const { return &**this; }
+        const Event& operator*()  const
+        {
+            return m_event_buffer->peek(Tier(m_tier), m_index[m_tier]);
+        }
+
+        /// The payload of the current Event; see EventBuffer::payload.
+        const char *payload() const { return m_event_buffer->payload(**this); }
 
         ConstReverseIterator &operator++();
         ConstReverseIterator  operator++(int);
 
-        /**
-         * Compare iterators for equality.
-         *
-         * Resolves the circular buffer iterator problem by considering two un-incremented
-         * iterators to the same index as UNequal. If we didn't do this, the begin() iterator
-         * on a full circular buffer would compare equal to the end() iterator. Not the
-         * most robust solution, but it handles the common case.
-         */
         bool operator==(const ConstReverseIterator&) const;
         bool operator!=(const ConstReverseIterator&) const;
     private:
+        /// Point m_tier at the tier holding the newest remaining Event.
+        void select();
+
         const EventBuffer* m_event_buffer = nullptr;
-        uint32_t m_current = 0;
-        unsigned m_increments = 0;
+        uint32_t m_index[TIER_COUNT] = {};
+        uint32_t m_remaining[TIER_COUNT] = {};
+        uint32_t m_tier = 0;
     };
 
 public:
-    /// Append an Event to this buffer, potentially overwriting the oldest event.
-    void push(const Event& event)
+    EventBuffer()
+    {
+        std::fill(std::begin(m_current), std::end(m_current), BUFFER_SIZE - 1);
+    }
+
+    /// Append an Event to the specified tier, potentially overwriting the tier's oldest event.
+    void push(const Event& event, Tier tier = HOT)
+    {
+        const uint32_t current = m_current[tier] = increment(m_current[tier], 1);
+
+#if USDT_PROBES_ENABLED
+        // Costs a well predicted branch on top of the probe's NOP, so only when probes are built.
+        // Slot zero is only occupied once the tier has been all the way around.
+        if (current == 0 && m_event[tier][0]) {
+            PROBE3(event__buffer__wrap, this, tier, event.timestamp);
+        }
+#endif
+
+        m_event[tier][current] = event;
+        m_event[tier][current].logical_time = ++m_logical_time;
+    }
+
+    /// Append an Event with a copy of the specified payload. See LOG_PAYLOAD.
+    void push(const Event& event, const void *data, uint32_t length)
+    {
+        if (length > MAX_PAYLOAD_SIZE) {
+            length = MAX_PAYLOAD_SIZE;
+        }
+
+        // Never let a payload straddle the end of the arena, so that it can be printed in place.
+        uint32_t offset = m_arena_head;
+        const uint32_t index = offset & ARENA_SIZE_MASK;
+
+        if (index + length > ARENA_SIZE) {
+            offset += ARENA_SIZE - index;
+        }
+
+        memcpy(&m_arena[offset & ARENA_SIZE_MASK], data, length);
+        m_arena_head = offset + length;
+
+        push(event);
+
+        Event &pushed = m_event[HOT][m_current[HOT]];
+        pushed.payload_offset = offset;
+        pushed.payload_length = length;
+        pushed.has_payload = true;
+    }
+
+    /**
+     * The payload of an Event in this buffer, for passing to Event::print. Returns null if the
+     * Event has no payload or its payload has since been overwritten, in which case Event::print
+     * prints a placeholder.
+     */
+    const char *payload(const Event& event) const
     {
-        m_current = increment(m_current, 1);
-        m_event[m_current] = event;
+        if (!event.has_payload) {
+            return nullptr;
+        }
+
+        if (m_arena_head - event.payload_offset > ARENA_SIZE) {
+            return nullptr;
+        }
+
+        return &m_arena[event.payload_offset & ARENA_SIZE_MASK];
+    }
+
+    /**
+     * The logical time to hand to another thread along with something it will synchronize on,
+     * e.g. stored next to a lock just before releasing it.
+     */
+    Event::logical_time_t send() const { return m_logical_time; }
+
+    /**
+     * Merge a logical time handed over by another thread, e.g. read from next to a lock just
+     * after acquiring it. Every Event pushed afterwards orders after the sender's Events.
+     *
+     * Only ever called by the owning thread, so no atomic operation is needed.
+     */
+    void receive(Event::logical_time_t time)
+    {
+        if (time > m_logical_time) {
+            m_logical_time = time;
+        }
     }
 
     /// Examine an entry in the buffer. Inlining is disabled to facilitate debugger use.
-    const Event& peek(uint32_t index) const __attribute__((noinline)) { return m_event[index]; }
-    const Event& peek()               const __attribute__((noinline)) { return peek(m_current); }
+    const Event& peek(Tier tier, uint32_t index) const __attribute__((noinline))
+    {
+        return m_event[tier][index];
+    }
+
+    /// Examine the latest entry in any tier. Inlining is disabled to facilitate debugger use.
+    const Event& peek() const __attribute__((noinline));
 
     // Iterator starting from the latest event which increments towards older events.
-    ConstReverseIterator rbegin() const { return ConstReverseIterator(this, m_current); }
+    ConstReverseIterator rbegin() const { return ConstReverseIterator(this); }
 
     // Iterator to one past the oldest event.
-    ConstReverseIterator rend() const;
+    ConstReverseIterator rend() const { return ConstReverseIterator(); }
 
     /**
      * Dump the buffer to stdout, marking all entries with the specified id number.
@@ -156,18 +329,49 @@ public:
      */
     void dump(unsigned id,
               Event::timestamp_t start_time = 0,
-              uint32_t count = BUFFER_SIZE) const __attribute__((noinline));
+              uint32_t count = TIER_COUNT * BUFFER_SIZE) const __attribute__((noinline));
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Inline Definitions
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+inline
+EventBuffer::ConstReverseIterator::ConstReverseIterator(const EventBuffer* event_buffer)
+    : m_event_buffer(event_buffer)
+{
+    for (uint32_t tier = 0; tier < TIER_COUNT; ++tier) {
+        m_index[tier] = event_buffer->m_current[tier];
+        m_remaining[tier] = event_buffer->size(Tier(tier));
+    }
+
+    select();
+}
+
+inline void
+EventBuffer::ConstReverseIterator::select()
+{
+    Event::logical_time_t newest = 0;
+
+    for (uint32_t tier = 0; tier < TIER_COUNT; ++tier) {
+        if (m_remaining[tier] > 0) {
+            const Event &event = m_event_buffer->peek(Tier(tier), m_index[tier]);
+
+            if (event.logical_time >= newest) {
+                newest = event.logical_time;
+                m_tier = tier;
+            }
+        }
+    }
+}
+
 inline EventBuffer::ConstReverseIterator &
 EventBuffer::ConstReverseIterator::operator++()
 {
-    m_current = EventBuffer::increment(m_current, -1);
-    ++m_increments;
+    m_index[m_tier] = EventBuffer::increment(m_index[m_tier], -1);
+    --m_remaining[m_tier];
+
+    select();
 
     return *this;
 }
@@ -185,7 +389,15 @@ EventBuffer::ConstReverseIterator::operator++(int)
 inline bool
 EventBuffer::ConstReverseIterator::operator==(const ConstReverseIterator &other) const
 {
-    return m_current == other.m_current && (m_increments > 0 || other.m_increments > 0);
+    for (uint32_t tier = 0; tier < TIER_COUNT; ++tier) {
+        if (m_remaining[tier] != other.m_remaining[tier] ||
+            (m_remaining[tier] > 0 && m_index[tier] != other.m_index[tier]))
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 inline bool
@@ -0,0 +1,193 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _executor_h
+#define _executor_h
+
+#if !defined(__cpp_impl_coroutine)
+#error "Executor.h requires C++20 coroutines; compile this file with -std=gnu++20"
+#endif
+
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class Definitions
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A minimal single-threaded scheduler for coroutines, as run by an event loop thread.
+ *
+ * Coroutines are resumed in FIFO order on the thread which calls run(). Exactly one other thread
+ * may post messages to the executor, which it then handles on its own thread; the two threads
+ * sharing a PetersonLock use this to wake each other's waiters. The message inbox is a single
+ * producer, single consumer ring which, in keeping with the locks, needs no atomic RMW.
+ */
+class Executor
+{
+public:
+    /// A function to call on the executor's thread, with its argument.
+    struct Message
+    {
+        void (*function)(void *);
+        void *context;
+    };
+
+private:
+    static constexpr uint32_t INBOX_SIZE = 64u;
+    static constexpr uint32_t INBOX_SIZE_MASK = INBOX_SIZE - 1;
+
+    static_assert((INBOX_SIZE & INBOX_SIZE_MASK) == 0, "INBOX_SIZE must be a power of 2");
+
+    std::deque<std::coroutine_handle<>> m_ready;
+
+    /// The number of Tasks spawned on this executor which have not yet finished.
+    unsigned m_task_count = 0;
+
+    Message m_inbox[INBOX_SIZE];
+    volatile uint32_t m_inbox_head = 0;   ///< Only written by the executor's thread.
+    volatile uint32_t m_inbox_tail = 0;   ///< Only written by the posting thread.
+
+    static inline thread_local Executor *t_current = nullptr;
+
+    friend class Task;
+
+public:
+    Executor() = default;
+    Executor(const Executor&) = delete;
+    Executor &operator=(const Executor&) = delete;
+
+    /// The executor running on the calling thread, if any.
+    static Executor *current() { return t_current; }
+
+    /// Queue a coroutine to be resumed. Only call from the executor's thread.
+    void schedule(std::coroutine_handle<> handle) { m_ready.push_back(handle); }
+
+    /// Queue a message to be handled on the executor's thread. Only call from the one other thread.
+    void post(const Message &message)
+    {
+        const uint32_t tail = m_inbox_tail;
+
+        while (tail - m_inbox_head == INBOX_SIZE) {
+            std::this_thread::yield();
+        }
+
+        m_inbox[tail & INBOX_SIZE_MASK] = message;
+
+        // x86 keeps the stores in order; just keep the compiler from reordering them.
+        asm volatile("" ::: "memory");
+        m_inbox_tail = tail + 1;
+    }
+
+    /// Run coroutines and handle messages on the calling thread until every Task has finished.
+    void run()
+    {
+        Executor *const previous = t_current;
+        t_current = this;
+
+        while (m_task_count > 0) {
+            drain_inbox();
+
+            if (m_ready.empty()) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::coroutine_handle<> handle = m_ready.front();
+            m_ready.pop_front();
+            handle.resume();
+        }
+
+        t_current = previous;
+    }
+
+    /// An awaitable which puts the awaiting coroutine at the back of the run queue.
+    auto yield()
+    {
+        struct Awaiter
+        {
+            Executor &executor;
+
+            bool await_ready() const { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.schedule(handle); }
+            void await_resume() const {}
+        };
+
+        return Awaiter{ *this };
+    }
+
+private:
+    void drain_inbox()
+    {
+        uint32_t head = m_inbox_head;
+
+        while (head != m_inbox_tail) {
+            asm volatile("" ::: "memory");
+            const Message message = m_inbox[head & INBOX_SIZE_MASK];
+            asm volatile("" ::: "memory");
+
+            m_inbox_head = ++head;
+            message.function(message.context);
+        }
+    }
+};
+
+/******************************************************************************/
+
+/**
+ * A fire-and-forget coroutine which runs on an Executor.
+ *
+ * The executor must be the coroutine's first parameter. The coroutine is scheduled on it when
+ * called, and destroys itself when it finishes.
+ */
+class Task
+{
+public:
+    struct promise_type
+    {
+        Executor &m_executor;
+
+        template <typename... Args>
+        promise_type(Executor &executor, Args&...)
+            : m_executor(executor)
+        {
+            ++m_executor.m_task_count;
+        }
+
+        ~promise_type() { --m_executor.m_task_count; }
+
+        Task get_return_object() { return Task(); }
+
+        auto initial_suspend() { return m_executor.yield(); }
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+#endif // _executor_h
@@ -0,0 +1,186 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <algorithm>
+
+#include "CacheLine.h"
+#include "Calibration.h"
+#include "Interference.h"
+
+constexpr InterferenceGenerator::Kind InterferenceGenerator::ALL_KINDS[];
+
+namespace {
+
+constexpr size_t CACHE_LINE_WORDS = CACHE_LINE_SIZE / sizeof(uint64_t);
+
+}
+
+const char *
+InterferenceGenerator::name(Kind kind)
+{
+    switch (kind) {
+        case Kind::NONE:         return "none";
+        case Kind::BANDWIDTH:    return "bandwidth";
+        case Kind::CACHE_THRASH: return "llc-thrash";
+        case Kind::FENCE_STORM:  return "mfence";
+        case Kind::ALU:          return "alu";
+    }
+
+    return "unknown";
+}
+
+size_t
+InterferenceGenerator::buffer_size(Kind kind, unsigned thread_count)
+{
+    switch (kind) {
+        case Kind::NONE:
+        case Kind::ALU:
+            return 0;
+
+        case Kind::FENCE_STORM:
+            return CACHE_LINE_WORDS * sizeof(uint64_t);
+
+        case Kind::BANDWIDTH:
+        case Kind::CACHE_THRASH:
+            break;
+    }
+
+    // Between them, the threads' buffers must be about twice the LLC to keep missing in it. Each
+    // is a power of two so thrash() can wrap its index with a mask.
+    const size_t target = std::max<size_t>(2 * calibration().llc_size / thread_count, 1u << 20);
+    size_t size = 1;
+
+    while (size < target) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+InterferenceGenerator::InterferenceGenerator(Kind kind, unsigned thread_count)
+    : m_kind(kind)
+    , m_buffer_size(buffer_size(kind, thread_count))
+{
+    if (kind == Kind::NONE) {
+        return;
+    }
+
+    // Allocate every buffer before starting any thread, which indexes m_buffer.
+    if (m_buffer_size > 0) {
+        m_buffer.reserve(thread_count);
+
+        for (unsigned i = 0; i < thread_count; ++i) {
+            // Touch every page up front so page faults don't pollute the measurement.
+            m_buffer.emplace_back(new uint64_t[m_buffer_size / sizeof(uint64_t)]());
+        }
+    }
+
+    for (unsigned i = 0; i < thread_count; ++i) {
+        m_thread.emplace_back(&InterferenceGenerator::run, this, i);
+    }
+}
+
+InterferenceGenerator::~InterferenceGenerator()
+{
+    m_stop = true;
+
+    for (auto &thread : m_thread) {
+        thread.join();
+    }
+}
+
+void
+InterferenceGenerator::run(unsigned index)
+{
+    switch (m_kind) {
+        case Kind::NONE:         break;
+        case Kind::BANDWIDTH:    stream(m_buffer[index].get());      break;
+        case Kind::CACHE_THRASH: thrash(m_buffer[index].get());      break;
+        case Kind::FENCE_STORM:  fence_storm(m_buffer[index].get()); break;
+        case Kind::ALU:          alu();                              break;
+    }
+}
+
+void
+InterferenceGenerator::stream(uint64_t *buffer)
+{
+    const size_t words = m_buffer_size / sizeof(uint64_t);
+    uint64_t sum = 0;
+
+    // Read the buffer and write it back in sequence, which the prefetchers turn into as much
+    // memory traffic as the core can sustain.
+    while (!m_stop) {
+        for (size_t i = 0; i < words; ++i) {
+            sum += buffer[i];
+            buffer[i] = sum;
+        }
+    }
+
+    m_sink = sum;
+}
+
+void
+InterferenceGenerator::thrash(uint64_t *buffer)
+{
+    const size_t lines = m_buffer_size / sizeof(uint64_t) / CACHE_LINE_WORDS;
+    uint64_t sum = 0;
+    size_t line = 0;
+
+    // Step through the lines with a large odd stride, defeating the prefetchers while still
+    // visiting every line, so each access evicts something from the LLC.
+    while (!m_stop) {
+        for (size_t i = 0; i < lines; ++i) {
+            line = (line + 4099) & (lines - 1);
+            sum += buffer[line * CACHE_LINE_WORDS]++;
+        }
+    }
+
+    m_sink = sum;
+}
+
+void
+InterferenceGenerator::fence_storm(uint64_t *buffer)
+{
+    uint64_t i = 0;
+
+    while (!m_stop) {
+        for (unsigned n = 0; n < 1024; ++n) {
+            buffer[0] = ++i;
+            asm volatile("mfence" ::: "memory");
+        }
+    }
+}
+
+void
+InterferenceGenerator::alu()
+{
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+
+    while (!m_stop) {
+        for (unsigned n = 0; n < 1024; ++n) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+    }
+
+    m_sink = x;
+}
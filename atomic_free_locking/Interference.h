@@ -0,0 +1,95 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _interference_h
+#define _interference_h
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs background threads which compete with a benchmark for shared machine resources, to see how
+ * a lock behaves next to noisy neighbors rather than on an otherwise idle machine.
+ *
+ * The threads start when the generator is constructed and stop when it is destroyed. They never
+ * touch the benchmark's memory; all interference is through shared hardware.
+ */
+class InterferenceGenerator
+{
+public:
+    enum class Kind
+    {
+        NONE,           ///< No interference; the clean-room baseline.
+        BANDWIDTH,      ///< Stream through a large buffer to saturate memory bandwidth.
+        CACHE_THRASH,   ///< Touch a new cache line of an LLC-sized buffer on every access.
+        FENCE_STORM,    ///< Store and mfence in a tight loop, loading the memory subsystem.
+        ALU,            ///< Dependent integer multiplies, competing with SMT siblings for ALUs.
+    };
+
+    static constexpr Kind ALL_KINDS[] = {
+        Kind::NONE, Kind::BANDWIDTH, Kind::CACHE_THRASH, Kind::FENCE_STORM, Kind::ALU,
+    };
+
+    /// A short human readable name for the specified kind of interference.
+    static const char *name(Kind kind);
+
+    /**
+     * Start the specified number of threads generating the specified kind of interference.
+     *
+     * Threads are not pinned, so ALU load lands on an SMT sibling of the benchmark only when the
+     * scheduler puts it there; use enough threads to cover all logical CPUs to make that likely.
+     */
+    InterferenceGenerator(Kind kind, unsigned thread_count);
+
+    /// Stop and join the interference threads.
+    ~InterferenceGenerator();
+
+    InterferenceGenerator(const InterferenceGenerator&) = delete;
+    InterferenceGenerator &operator=(const InterferenceGenerator&) = delete;
+
+private:
+    /// The size of each thread's buffer, for the kinds which need one.
+    static size_t buffer_size(Kind kind, unsigned thread_count);
+
+    void run(unsigned index);
+
+    void stream(uint64_t *buffer);
+    void thrash(uint64_t *buffer);
+    void fence_storm(uint64_t *buffer);
+    void alu();
+
+    const Kind m_kind;
+    const size_t m_buffer_size;
+    volatile bool m_stop = false;
+    std::vector<std::thread> m_thread;
+
+    /// One private buffer per thread, for the kinds which need one.
+    std::vector<std::unique_ptr<uint64_t[]>> m_buffer;
+
+    /// Results are accumulated here so the compiler can't discard the work.
+    volatile uint64_t m_sink = 0;
+};
+
+#endif // _interference_h
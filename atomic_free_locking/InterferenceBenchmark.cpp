@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <thread>
+
+#include "AdaptiveLock.h"
+#include "Benchmarks.h"
+#include "Interference.h"
+#include "Latency.h"
+#include "MutexLock.h"
+#include "PetersonLock.h"
+
+using std::this_thread::yield;
+using WaitFunction = __typeof__(&yield);
+
+namespace {
+
+struct Result
+{
+    double         throughput;  ///< Acquisitions per microsecond, both threads combined.
+    LatencySummary latency;     ///< Acquire latency.
+};
+
+/// Time the specified lock from two threads with no work besides acquiring it.
+template <typename Lock>
+Result time_lock(unsigned loop_count)
+{
+    Lock lock(&yield);
+    const TwoThreadResult measured = time_two_threads(lock, loop_count);
+
+    Result result;
+    result.throughput = measured.throughput;
+    result.latency = measured.combined_latency();
+
+    return result;
+}
+
+void print_result(const char *lock_name, const Result &result, const Result &baseline)
+{
+    printf("  %-10s %10.2f (%5.2fx) %10.0f %10.0f %10.0f %12.0f\n",
+           lock_name,
+           result.throughput,
+           baseline.throughput / result.throughput,
+           result.latency.p50,
+           result.latency.p99,
+           result.latency.p999,
+           result.latency.max);
+}
+
+} // anonymous namespace
+
+void benchmark_interference(unsigned loop_count)
+{
+    // Leave room for the two lock threads, but always generate some interference.
+    const unsigned hardware_threads = std::thread::hardware_concurrency();
+    const unsigned thread_count = hardware_threads > 3 ? hardware_threads - 2 : 1;
+
+    Result baseline[3] = {};
+
+    printf("Lock behavior under interference, %u iterations per thread, %u interference threads\n",
+           loop_count, thread_count);
+    printf("Throughput in acquisitions/us (slowdown vs. no interference); latencies in ns\n");
+
+    for (auto kind : InterferenceGenerator::ALL_KINDS) {
+        Result result[3];
+
+        {
+            InterferenceGenerator interference(kind, thread_count);
+
+            result[0] = time_lock<PetersonLock<WaitFunction, true>>(loop_count);
+            result[1] = time_lock<MutexLock<WaitFunction>>(loop_count);
+            result[2] = time_lock<AdaptiveLock<WaitFunction>>(loop_count);
+        }
+
+        if (kind == InterferenceGenerator::Kind::NONE) {
+            std::copy(result, result + 3, baseline);
+        }
+
+        printf("%s:\n", InterferenceGenerator::name(kind));
+        printf("  %-10s %19s %10s %10s %10s %12s\n",
+               "lock", "throughput", "p50", "p99", "p99.9", "max");
+        print_result("peterson", result[0], baseline[0]);
+        print_result("mutex",    result[1], baseline[1]);
+        print_result("adaptive", result[2], baseline[2]);
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <algorithm>
+
+#include "Calibration.h"
+#include "Latency.h"
+
+double
+ticks_to_ns(double ticks)
+{
+    return ticks * calibration().ns_per_tick;
+}
+
+LatencySummary
+summarize_latency(std::vector<uint64_t> &samples)
+{
+    LatencySummary summary;
+
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](double p) { return ticks_to_ns(samples[size_t(p * (samples.size() - 1))]); };
+
+    double total = 0;
+
+    for (uint64_t sample : samples) {
+        total += sample;
+    }
+
+    summary.mean = ticks_to_ns(total / samples.size());
+    summary.p50  = percentile(0.5);
+    summary.p99  = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.max  = ticks_to_ns(samples.back());
+
+    return summary;
+}
@@ -0,0 +1,155 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _latency_h
+#define _latency_h
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <mach/mach_time.h>
+
+#include "Barrier.h"
+
+/// Summary statistics of a set of latency samples, in nanoseconds.
+struct LatencySummary
+{
+    double mean = 0;
+    double p50  = 0;
+    double p99  = 0;
+    double p999 = 0;
+    double max  = 0;
+};
+
+/// Convert a mach_absolute_time interval to nanoseconds.
+double ticks_to_ns(double ticks);
+
+/// Summarize latency samples measured in mach_absolute_time units. Sorts the samples in place.
+LatencySummary summarize_latency(std::vector<uint64_t> &samples);
+
+/// Burn the specified number of loop iterations without touching shared memory.
+inline void think(unsigned iterations)
+{
+    for (unsigned i = 0; i < iterations; ++i) {
+        asm volatile("");
+    }
+}
+
+/// The measurements taken by time_two_threads.
+struct TwoThreadResult
+{
+    double throughput = 0;              ///< Acquisitions per microsecond, both threads combined.
+    std::vector<uint64_t> latency[2];   ///< Each thread's acquire latencies, in ticks.
+    bool violated = false;              ///< Whether both threads were ever inside at once.
+
+    /// Summarize both threads' acquire latencies together.
+    LatencySummary combined_latency() const
+    {
+        std::vector<uint64_t> all(latency[0]);
+        all.insert(all.end(), latency[1].begin(), latency[1].end());
+
+        return summarize_latency(all);
+    }
+};
+
+/// A per-thread hook for time_two_threads which does nothing.
+struct NoThreadHook
+{
+    void operator()(bool) const {}
+};
+
+/**
+ * Hammer the specified lock from two threads, recording the latency of every acquisition.
+ *
+ * Each thread acquires the lock loop_count times, spending critical_work iterations of think()
+ * inside the critical section and outside_work outside of it. setup() is called on each thread
+ * before the threads start together, and finish() after its last release, with the thread's
+ * number.
+ */
+template <typename Lock, typename Setup = NoThreadHook, typename Finish = NoThreadHook>
+TwoThreadResult time_two_threads(Lock &lock,
+                                 unsigned loop_count,
+                                 unsigned critical_work = 0,
+                                 unsigned outside_work = 0,
+                                 Setup setup = Setup(),
+                                 Finish finish = Finish())
+{
+    using WaitFunction = __typeof__(&std::this_thread::yield);
+
+    SenseReversingBarrier<WaitFunction> barrier(2, &std::this_thread::yield);
+    std::thread thread[2];
+    uint64_t start_time = 0, end_time = 0;
+    volatile int shared_value = 0;
+    volatile bool violated = false;
+    TwoThreadResult result;
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        result.latency[tid].resize(loop_count);
+
+        thread[tid] = std::thread([&, tid]()
+        {
+            uint64_t *sample = result.latency[tid].data();
+
+            setup(bool(tid));
+
+            barrier.wait(tid);
+            if (tid == 0) {
+                start_time = mach_absolute_time();
+            }
+
+            for (unsigned i = 0; i < loop_count; ++i) {
+                const uint64_t before = mach_absolute_time();
+                lock.acquire(bool(tid));
+                sample[i] = mach_absolute_time() - before;
+
+                shared_value = shared_value + 1;
+                if (shared_value != 1) {
+                    violated = true;
+                }
+                think(critical_work);
+                shared_value = shared_value - 1;
+
+                lock.release(bool(tid));
+                think(outside_work);
+            }
+
+            finish(bool(tid));
+
+            barrier.wait(tid);
+            if (tid == 0) {
+                end_time = mach_absolute_time();
+            }
+        });
+    }
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid].join();
+    }
+
+    result.throughput = 2.0 * loop_count / (ticks_to_ns(end_time - start_time) / 1000);
+    result.violated = violated;
+
+    return result;
+}
+
+#endif // _latency_h
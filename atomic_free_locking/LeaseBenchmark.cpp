@@ -0,0 +1,101 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <thread>
+
+#include "Benchmarks.h"
+#include "Latency.h"
+#include "LeasedLock.h"
+#include "PetersonLock.h"
+
+using std::this_thread::yield;
+using WaitFunction = __typeof__(&yield);
+
+namespace {
+
+/// Work done inside and outside of the critical section, in iterations of think().
+const unsigned CRITICAL_WORK = 20;
+const unsigned OUTSIDE_WORK  = 20;
+
+/// Give up any lease the thread holds, for the locks which have them.
+template <typename Lock>
+void relinquish(Lock &, bool) {}
+
+template <typename WaitFunction, bool fenced>
+void relinquish(LeasedPetersonLock<WaitFunction, fenced> &lock, bool thread)
+{
+    lock.relinquish(thread);
+}
+
+/**
+ * Hammer a lock constructed with the specified arguments from two threads, reporting throughput
+ * and the acquire latency of both threads combined.
+ */
+template <typename Lock, typename... Args>
+void time_lock(const char *lock_name, unsigned loop_count, Args... args)
+{
+    Lock lock(&yield, args...);
+
+    const TwoThreadResult result = time_two_threads(lock, loop_count, CRITICAL_WORK, OUTSIDE_WORK,
+                                                    NoThreadHook(),
+                                                    [&](bool thread) { relinquish(lock, thread); });
+
+    if (result.violated) {
+        printf("%s: lock violation detected!\n", lock_name);
+    }
+
+    const LatencySummary summary = result.combined_latency();
+
+    printf("%-16s %10.2f %10.0f %10.0f %10.0f %10.0f %12.0f\n",
+           lock_name,
+           result.throughput,
+           summary.mean,
+           summary.p50,
+           summary.p99,
+           summary.p999,
+           summary.max);
+}
+
+} // anonymous namespace
+
+void benchmark_lease(unsigned loop_count)
+{
+    using Leased = LeasedPetersonLock<WaitFunction, true>;
+
+    const uint64_t unbounded = UINT64_MAX / 2;
+
+    printf("Leased vs. plain acquire/release, %u iterations per thread\n", loop_count);
+    printf("Throughput in acquisitions/us; acquire latencies in ns\n");
+    printf("%-16s %10s %10s %10s %10s %10s %12s\n",
+           "lock", "throughput", "mean", "p50", "p99", "p99.9", "max");
+
+    time_lock<PetersonLock<WaitFunction, true>>("peterson", loop_count);
+
+    time_lock<Leased>("leased N=4", loop_count, 4u, unbounded);
+    time_lock<Leased>("leased N=16", loop_count, 16u, unbounded);
+    time_lock<Leased>("leased N=64", loop_count, 64u, unbounded);
+    time_lock<Leased>("leased T=1us", loop_count, UINT32_MAX, Leased::ns_to_cycles(1'000));
+    time_lock<Leased>("leased T=10us", loop_count, UINT32_MAX, Leased::ns_to_cycles(10'000));
+    time_lock<Leased>("leased default", loop_count);
+}
@@ -0,0 +1,156 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _leased_lock_h
+#define _leased_lock_h
+
+#include <cstdint>
+#include <cassert>
+#include <x86intrin.h>
+
+#include "CacheLine.h"
+#include "Calibration.h"
+#include "PetersonLock.h"
+
+/**
+ * A PetersonLock which its holder may keep across several critical sections.
+ *
+ * Handing a lock over costs a cache miss on each flag, plus a fence on the next acquisition, even
+ * when the other thread doesn't want the lock. Under a lease, release() keeps the lock unless the
+ * other thread's interest flag is visible, so a thread running a series of short critical sections
+ * pays for one acquisition. The lease ends, handing the lock over, after max_sections critical
+ * sections or max_cycles TSC cycles, whichever comes first, bounding how long a waiter whose
+ * interest hasn't become visible yet can be held up.
+ *
+ * Checking the other thread's flag is only a hint, so it needs no fence: a flag which isn't
+ * visible yet just delays the handover until it is, or until the lease runs out.
+ *
+ * A thread holding a lease keeps the lock between critical sections, so it must call relinquish()
+ * before it stops using the lock, or the other thread will wait for it forever.
+ */
+template <typename WaitFunction, bool fenced>
+class LeasedPetersonLock
+{
+    /// The default maximum number of critical sections per lease.
+    static constexpr uint32_t DEFAULT_MAX_SECTIONS = 16;
+
+    /// The default maximum duration of a lease, in nanoseconds.
+    static constexpr double DEFAULT_MAX_NS = 10'000;
+
+    /// A thread's lease. Only accessed by its own thread.
+    struct Lease
+    {
+        bool     held = false;      ///< Whether the thread kept the lock at its last release.
+        uint32_t sections = 0;      ///< Critical sections since the lock was last acquired.
+        uint64_t expiry = 0;        ///< TSC value at which the lease runs out.
+    };
+
+    PetersonLock<WaitFunction, fenced> m_lock;
+
+    const uint32_t m_max_sections;
+    const uint64_t m_max_cycles;
+
+    /// Each on its own cache line, off the lock's line which the waiting thread spins on, and off
+    /// the other thread's lease.
+    CacheLinePadded<Lease> m_lease[2];
+
+public:
+    LeasedPetersonLock(WaitFunction wait_function,
+                       uint32_t max_sections = DEFAULT_MAX_SECTIONS,
+                       uint64_t max_cycles = ns_to_cycles(DEFAULT_MAX_NS))
+        : m_lock(wait_function)
+        , m_max_sections(max_sections)
+        , m_max_cycles(max_cycles)
+    {}
+
+    /// Convert nanoseconds to TSC cycles using the machine's calibration.
+    static uint64_t ns_to_cycles(double ns)
+    {
+        return uint64_t(ns / calibration().ns_per_tick * calibration().cycles_per_tick);
+    }
+
+    /**
+     * Acquire the lock for the specified thread (0 or 1), returning immediately if the thread
+     * still holds a lease.
+     *
+     * Returns the number of times the wait function was called, a cheap measure of contention.
+     */
+    unsigned acquire(bool thread)
+    {
+        Lease &lease = m_lease[thread];
+
+        if (lease.held) {
+            ++lease.sections;
+            return 0;
+        }
+
+        const unsigned spins = m_lock.acquire(thread);
+
+        lease.held = true;
+        lease.sections = 1;
+        lease.expiry = __rdtsc() + m_max_cycles;
+
+        return spins;
+    }
+
+    /**
+     * End a critical section for the specified thread (0 or 1), keeping the lock unless the other
+     * thread wants it or the lease has run out.
+     */
+    void release(bool thread)
+    {
+        Lease &lease = m_lease[thread];
+
+        assert(lease.held);
+
+        if (lease.sections < m_max_sections &&
+            !m_lock.state().interested[!thread] &&
+            __rdtsc() < lease.expiry)
+        {
+            // Keep the critical section's accesses inside it, as a release would.
+            asm volatile("" ::: "memory");
+            return;
+        }
+
+        relinquish(thread);
+    }
+
+    /// Hand the lock over if the specified thread (0 or 1) still holds a lease on it.
+    void relinquish(bool thread)
+    {
+        Lease &lease = m_lease[thread];
+
+        if (lease.held) {
+            lease.held = false;
+            m_lock.release(thread);
+        }
+    }
+
+    /// See PetersonLock::state.
+    LockState state() const { return m_lock.state(); }
+
+    /// This lock's ownership history, or null if it isn't recorded.
+    const LockHistory *history() const { return m_lock.history(); }
+};
+
+#endif // _leased_lock_h
@@ -0,0 +1,52 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include "LockHistory.h"
+
+void
+LockHistory::Entry::print(const void *lock, Event::timestamp_t start_time) const
+{
+    if (this->acquired) {
+        printf("%6llu (%6s): [%3u] lock %p acquired after %u spins\n",
+               (unsigned long long)(this->timestamp - start_time),
+               "",
+               this->thread,
+               lock,
+               this->spins);
+    } else {
+        printf("%6llu (%6s): [%3u] lock %p released\n",
+               (unsigned long long)(this->timestamp - start_time),
+               "",
+               this->thread,
+               lock);
+    }
+}
+
+void
+LockHistory::dump(const void *lock, Event::timestamp_t start_time) const
+{
+    for (uint32_t age = 0; age < HISTORY_SIZE && peek(age); ++age) {
+        peek(age).print(lock, start_time);
+    }
+}
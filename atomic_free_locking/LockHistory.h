@@ -0,0 +1,132 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _lock_history_h
+#define _lock_history_h
+
+#include <cstdint>
+#include <mach/mach_time.h>
+
+#include "EventBuffer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class Definitions
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A small circular record of a single lock's recent owners, embedded in the lock itself.
+ *
+ * Whereas an EventBuffer shows what one thread did, a LockHistory shows what happened to one
+ * lock: who acquired it, when, after how much spinning, and when they let it go. Entries are only
+ * ever written by the thread holding the lock (acquisitions just after acquiring, releases just
+ * before releasing) so the lock itself serializes all writes.
+ *
+ * When the lock is broken, of course, both threads may write at once. That's exactly when the
+ * history is interesting, and a torn entry or two is a fair price for not synchronizing.
+ */
+class LockHistory
+{
+public:
+    static constexpr uint32_t HISTORY_SIZE = 32u;
+
+    struct Entry
+    {
+        Event::timestamp_t timestamp = 0;   ///< Zero for an unused entry.
+        uint32_t           spins     = 0;   ///< The spin count of an acquisition.
+        uint8_t            thread    = 0;
+        bool               acquired  = false;
+
+        explicit operator bool() const { return this->timestamp != 0; }
+
+        /**
+         * Print this Entry to stdout in the same format as Event::print, for interleaving with
+         * EventBuffer dumps.
+         *
+         * Disallow inlining to facilitate use in debugger
+         */
+        void print(const void *lock, Event::timestamp_t start_time) const __attribute__((noinline));
+    };
+
+private:
+    static constexpr uint32_t HISTORY_SIZE_MASK = HISTORY_SIZE - 1;
+
+    static_assert((HISTORY_SIZE & HISTORY_SIZE_MASK) == 0,
+                  "HISTORY_SIZE must be a power of 2 for record() to work");
+
+    uint32_t m_next = 0;
+    Entry m_entry[HISTORY_SIZE];
+
+    void record(bool thread, bool acquired, uint32_t spins)
+    {
+        // Keep the compiler from moving the writes outside of the critical section.
+        asm volatile("" ::: "memory");
+
+        Entry &entry = m_entry[m_next];
+
+        entry.timestamp = mach_absolute_time();
+        entry.spins     = spins;
+        entry.thread    = thread;
+        entry.acquired  = acquired;
+
+        m_next = (m_next + 1) & HISTORY_SIZE_MASK;
+
+        asm volatile("" ::: "memory");
+    }
+
+public:
+    /// Record an acquisition by the specified thread. Call only once the lock is held.
+    void record_acquire(bool thread, uint32_t spins) { record(thread, true, spins); }
+
+    /// Record a release by the specified thread. Call only while the lock is still held.
+    void record_release(bool thread) { record(thread, false, 0); }
+
+    /// The history itself, for locks which may or may not keep one.
+    const LockHistory *get() const { return this; }
+
+    /// Examine an entry by age, with zero being the newest. Unused entries test false.
+    const Entry &peek(uint32_t age) const
+    {
+        return m_entry[(m_next - 1 - age) & HISTORY_SIZE_MASK];
+    }
+
+    /**
+     * Dump the history to stdout, newest first, labelling each entry with the specified lock.
+     *
+     * Inlining is disabled to facilitate debugger use.
+     */
+    void dump(const void *lock, Event::timestamp_t start_time = 0) const __attribute__((noinline));
+};
+
+/******************************************************************************/
+
+/// Stands in for LockHistory in locks which don't keep one, at no cost.
+class NoLockHistory
+{
+public:
+    void record_acquire(bool, uint32_t) {}
+    void record_release(bool) {}
+
+    const LockHistory *get() const { return nullptr; }
+};
+
+#endif // _lock_history_h
@@ -0,0 +1,175 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "EventBuffer.h"
+#include "LockOrder.h"
+
+thread_local LockOrderValidator::ThreadState LockOrderValidator::t_state;
+volatile uint32_t LockOrderValidator::s_generation = 0;
+
+namespace {
+
+/// For each lock, the locks which have been acquired while holding it. Guarded by graph_mutex.
+std::unordered_map<const void *, std::vector<const void *>> graph;
+std::mutex graph_mutex;
+
+/**
+ * Search the graph for a path from one lock to another, returning whether one exists. On success,
+ * the path is left in 'path', starting at 'from' and ending at 'to'.
+ */
+bool find_path(const void *from, const void *to, std::vector<const void *> &path)
+{
+    path.push_back(from);
+
+    if (from == to) {
+        return true;
+    }
+
+    auto successors = graph.find(from);
+
+    if (successors != graph.end()) {
+        for (const void *next : successors->second) {
+            // The graph is acyclic, since we never add an edge which would close a cycle, so the
+            // search always terminates. It may revisit nodes, but lock graphs are small.
+            if (find_path(next, to, path)) {
+                return true;
+            }
+        }
+    }
+
+    path.pop_back();
+    return false;
+}
+
+} // anonymous namespace
+
+void
+LockOrderValidator::set_event_buffer(const EventBuffer *event_buffer, unsigned id)
+{
+    t_state.event_buffer    = event_buffer;
+    t_state.event_buffer_id = id;
+}
+
+void
+LockOrderValidator::check_edge(const void *from, const void *to)
+{
+    ThreadState &state = t_state;
+    std::vector<const void *> path;
+    bool cycle;
+
+    {
+        std::lock_guard<std::mutex> guard(graph_mutex);
+        std::vector<const void *> &successors = graph[from];
+
+        bool known = false;
+
+        for (const void *successor : successors) {
+            known = known || successor == to;
+        }
+
+        // Acquiring 'to' while holding 'from' is a problem if somebody has ever (transitively)
+        // acquired 'from' while holding 'to'.
+        cycle = !known && find_path(to, from, path);
+
+        if (!known && !cycle) {
+            successors.push_back(to);
+        }
+    }
+
+    // Cache the edge whether or not it was bad, so each thread reports a given violation once.
+    state.edge_cache[edge_hash(from, to)] = Edge{ from, to };
+
+    if (!cycle) {
+        return;
+    }
+
+    printf("Lock order violation: acquiring lock %p while holding lock %p\n", to, from);
+    printf("Previously established order:\n");
+
+    for (const void *lock : path) {
+        printf("    %p\n", lock);
+    }
+
+    printf("Locks held by this thread, innermost first:\n");
+
+    for (unsigned i = state.depth; i-- > 0;) {
+        printf("    %p\n", state.held[i]);
+    }
+
+    if (state.event_buffer) {
+        printf("Dumping event buffer:\n");
+        state.event_buffer->dump(state.event_buffer_id);
+    }
+}
+
+void
+LockOrderValidator::forget(const void *lock)
+{
+    std::lock_guard<std::mutex> guard(graph_mutex);
+
+    // Only locks which have been nested have a node to remove.
+    bool found = graph.erase(lock) > 0;
+
+    for (auto &node : graph) {
+        std::vector<const void *> &successors = node.second;
+        const auto end = std::remove(successors.begin(), successors.end(), lock);
+
+        found = found || end != successors.end();
+        successors.erase(end, successors.end());
+    }
+
+    // Cached edges to or from the lock would skip checking its successor at the same address.
+    if (found) {
+        s_generation = s_generation + 1;
+    }
+}
+
+void
+LockOrderValidator::flush_edge_cache()
+{
+    ThreadState &state = t_state;
+
+    for (Edge &edge : state.edge_cache) {
+        edge = Edge{ nullptr, nullptr };
+    }
+
+    state.generation = s_generation;
+}
+
+void
+LockOrderValidator::report_overflow(const void *lock)
+{
+    printf("Lock order validation: too many locks held acquiring %p; not tracking it\n", lock);
+}
+
+void
+LockOrderValidator::report_unheld(const void *lock)
+{
+    printf("Lock order validation: releasing lock %p which is not held\n", lock);
+}
@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _lock_order_h
+#define _lock_order_h
+
+#include <cstdint>
+
+class EventBuffer;
+
+/**
+ * Define ENABLE_LOCK_ORDER_VALIDATION to have PetersonLock check that nested locks are always
+ * acquired in a consistent order, in the manner of the Linux kernel's lockdep.
+ *
+ * Two threads which nest the same pair of locks in opposite orders can deadlock, and with spin
+ * locks the deadlock is silent. The validator catches the inconsistency the first time it *could*
+ * happen rather than the rare time it does.
+ */
+#if ENABLE_LOCK_ORDER_VALIDATION
+#define LOCK_ORDER_ACQUIRE(lock) LockOrderValidator::acquire(lock)
+#define LOCK_ORDER_RELEASE(lock) LockOrderValidator::release(lock)
+#define LOCK_ORDER_FORGET(lock)  LockOrderValidator::forget(lock)
+#else
+#define LOCK_ORDER_ACQUIRE(lock) do {} while (0)
+#define LOCK_ORDER_RELEASE(lock) do {} while (0)
+#define LOCK_ORDER_FORGET(lock)  do {} while (0)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Class Definitions
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Validates lock ordering against a global graph of "acquired while holding" edges.
+ *
+ * Every thread keeps a stack of the locks it holds. Acquiring a lock while holding another adds
+ * an edge from the held lock to the new one, and an edge which would close a cycle is a potential
+ * deadlock. Checking the global graph needs a mutex, so each thread also caches the edges it has
+ * already checked. In the steady state, acquire() and release() touch only thread-local memory:
+ * a stack push and pop, plus a cache probe when the thread already holds another lock.
+ *
+ * Locks are identified by address, so a lock must be forgotten when it is destroyed, lest a later
+ * object at the same address inherit its edges. Forgetting a lock also invalidates every thread's
+ * edge cache, which is cheap to check for and rare.
+ *
+ * Violations are reported on stdout along with the reporting thread's EventBuffer, if it has
+ * registered one.
+ */
+class LockOrderValidator
+{
+public:
+    /// Deeper nesting than this is almost certainly a bug in itself.
+    static constexpr unsigned MAX_HELD = 16;
+
+    /// Register the calling thread's EventBuffer, and the id to mark its events with, for dumping
+    /// in violation reports.
+    static void set_event_buffer(const EventBuffer *event_buffer, unsigned id);
+
+    /// Record that the calling thread is about to acquire the specified lock.
+    static void acquire(const void *lock);
+
+    /// Record that the calling thread has released the specified lock.
+    static void release(const void *lock);
+
+    /// Remove a lock which is being destroyed, and all of its edges, from the graph.
+    static void forget(const void *lock);
+
+private:
+    /// The number of cached edges per thread. Must be a power of 2.
+    static constexpr unsigned EDGE_CACHE_SIZE = 256;
+
+    struct Edge
+    {
+        const void *from;
+        const void *to;
+    };
+
+    struct ThreadState
+    {
+        // Everything is initialized so that the thread_local needs no dynamic initialization.
+        const void        *held[MAX_HELD] = {};
+        unsigned           depth = 0;
+        unsigned           overflow = 0;        ///< Locks acquired beyond MAX_HELD, untracked.
+        uint32_t           generation = 0;      ///< The value of s_generation edge_cache matches.
+        Edge               edge_cache[EDGE_CACHE_SIZE] = {};
+        const EventBuffer *event_buffer = nullptr;
+        unsigned           event_buffer_id = 0;
+    };
+
+    static thread_local ThreadState t_state;
+
+    /// Bumped by forget(), invalidating every thread's edge cache.
+    static volatile uint32_t s_generation;
+
+    static unsigned edge_hash(const void *from, const void *to)
+    {
+        const uintptr_t key = uintptr_t(from) * 31 ^ uintptr_t(to);
+        return unsigned(key >> 4) & (EDGE_CACHE_SIZE - 1);
+    }
+
+    /// Check an edge against the global graph and add it if it doesn't close a cycle.
+    static void check_edge(const void *from, const void *to) __attribute__((noinline));
+
+    /// Empty the calling thread's edge cache after a lock has been forgotten.
+    static void flush_edge_cache() __attribute__((noinline));
+
+    static void report_overflow(const void *lock) __attribute__((noinline));
+    static void report_unheld(const void *lock) __attribute__((noinline));
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Inline Definitions
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline void
+LockOrderValidator::acquire(const void *lock)
+{
+    ThreadState &state = t_state;
+
+    if (state.generation != s_generation) {
+        flush_edge_cache();
+    }
+
+    if (state.depth > 0) {
+        const void *held = state.held[state.depth - 1];
+        const Edge &cached = state.edge_cache[edge_hash(held, lock)];
+
+        if (cached.from != held || cached.to != lock) {
+            check_edge(held, lock);
+        }
+    }
+
+    if (state.depth == MAX_HELD) {
+        ++state.overflow;
+        report_overflow(lock);
+        return;
+    }
+
+    state.held[state.depth++] = lock;
+}
+
+inline void
+LockOrderValidator::release(const void *lock)
+{
+    ThreadState &state = t_state;
+
+    // Locks are nearly always released in LIFO order.
+    if (state.depth > 0 && state.held[state.depth - 1] == lock) {
+        --state.depth;
+        return;
+    }
+
+    for (unsigned i = state.depth; i-- > 0;) {
+        if (state.held[i] == lock) {
+            for (; i + 1 < state.depth; ++i) {
+                state.held[i] = state.held[i + 1];
+            }
+            --state.depth;
+            return;
+        }
+    }
+
+    // Presumably one of the locks acquired past MAX_HELD, which were already reported.
+    if (state.overflow > 0) {
+        --state.overflow;
+        return;
+    }
+
+    report_unheld(lock);
+}
+
+#endif // _lock_order_h
@@ -0,0 +1,143 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <chrono>
+#include <cstdio>
+
+#include "Calibration.h"
+#include "LockSampler.h"
+
+LockSampler::LockSampler(uint64_t interval_ns)
+    : m_interval_ns(interval_ns)
+{}
+
+LockSampler::~LockSampler()
+{
+    stop();
+}
+
+void
+LockSampler::start()
+{
+    if (!m_sampler.joinable()) {
+        m_stop = false;
+        m_sampler = std::thread(&LockSampler::run, this);
+    }
+}
+
+void
+LockSampler::stop()
+{
+    if (m_sampler.joinable()) {
+        m_stop = true;
+        m_sampler.join();
+    }
+}
+
+void
+LockSampler::run()
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto interval = std::chrono::nanoseconds(m_interval_ns);
+    // Sleeping can't honor an interval shorter than the scheduler's shortest sleep.
+    const bool spin = m_interval_ns < 2 * calibration().sleep_ns;
+    auto next = clock::now();
+
+    while (!m_stop) {
+        sample();
+
+        next += interval;
+
+        if (spin) {
+            while (clock::now() < next) {
+                std::this_thread::yield();
+            }
+        } else {
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+void
+LockSampler::sample()
+{
+    for (LockTally &tally : m_lock) {
+        const LockState state = tally.read(tally.lock);
+
+        ++tally.samples;
+
+        if (state.interested[0] && state.interested[1]) {
+            const bool holder = state.thread_priority;
+
+            ++tally.contended;
+            ++tally.held[holder];
+            ++tally.waiting[!holder];
+        } else if (state.interested[0] || state.interested[1]) {
+            ++tally.held[state.interested[1]];
+        }
+    }
+
+    for (ThreadTally &tally : m_thread) {
+        // The writer may be mid-push, in which case we see the event it's about to overwrite.
+        // That's no worse than sampling a moment earlier.
+        const Event &event = tally.event_buffer->peek();
+
+        if (event) {
+            ++tally.samples;
+            ++tally.line[event.line];
+        }
+    }
+}
+
+void
+LockSampler::report() const
+{
+    auto percent = [](uint64_t count, uint64_t total) { return total ? 100.0 * count / total : 0.0; };
+
+    for (const LockTally &tally : m_lock) {
+        const uint64_t held = tally.held[0] + tally.held[1];
+
+        printf("Lock %s: %llu samples\n", tally.name, (unsigned long long)tally.samples);
+        printf("    held      %6.2f%%  (thread 0 %6.2f%%, thread 1 %6.2f%%)\n",
+               percent(held, tally.samples),
+               percent(tally.held[0], tally.samples),
+               percent(tally.held[1], tally.samples));
+        printf("    waiting   %6.2f%%  (thread 0 %6.2f%%, thread 1 %6.2f%%)\n",
+               percent(tally.waiting[0] + tally.waiting[1], tally.samples),
+               percent(tally.waiting[0], tally.samples),
+               percent(tally.waiting[1], tally.samples));
+        printf("    contended %6.2f%% of samples, %6.2f%% of samples while held\n",
+               percent(tally.contended, tally.samples),
+               percent(tally.contended, held));
+    }
+
+    for (const ThreadTally &tally : m_thread) {
+        printf("Thread %s: %llu samples\n", tally.name, (unsigned long long)tally.samples);
+
+        for (const auto &line : tally.line) {
+            printf("    last logged from line %4u  %6.2f%%\n",
+                   line.first, percent(line.second, tally.samples));
+        }
+    }
+}
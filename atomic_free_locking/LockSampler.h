@@ -0,0 +1,126 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _lock_sampler_h
+#define _lock_sampler_h
+
+#include <cstdint>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "EventBuffer.h"
+#include "PetersonLock.h"
+
+/**
+ * A sampling profiler for lock state which adds nothing at all to the code being observed.
+ *
+ * Even a counter increment in acquire() perturbs the races this project studies. Instead, a
+ * sampler thread periodically reads each registered lock's m_interested and m_thread_priority,
+ * and the latest Event in each registered thread's EventBuffer, and tallies what it sees. It only
+ * ever writes its own private tallies.
+ *
+ * From the lock state alone we can tell, for each thread, whether it is holding the lock or
+ * waiting for it: a thread which alone is interested holds the lock, and when both are
+ * interested, the one named by m_thread_priority arrived first and holds it while the other
+ * waits. The brief window between a thread announcing its interest and checking the other's is
+ * counted as holding, so hold fractions are slight overestimates. The latest logged Event tells
+ * us roughly where each thread is in its own code.
+ *
+ * Register locks and threads before calling start(). Registered objects must outlive the sampling.
+ */
+class LockSampler
+{
+public:
+    /// Sample every interval_ns nanoseconds. Intervals under twice the calibrated sleep latency
+    /// (Calibration::sleep_ns) are timed by polling the clock, since sleeping couldn't honor them.
+    explicit LockSampler(uint64_t interval_ns);
+
+    /// Stops sampling if it's still running.
+    ~LockSampler();
+
+    LockSampler(const LockSampler&) = delete;
+    LockSampler &operator=(const LockSampler&) = delete;
+
+    /// Register a lock providing a LockState state() method, such as PetersonLock.
+    template <typename Lock>
+    void add_lock(const char *name, const Lock &lock)
+    {
+        m_lock.push_back(LockTally{ name, &lock, &read_state<Lock> });
+    }
+
+    /// Register a thread by its EventBuffer, to track the call site it last logged from.
+    void add_thread(const char *name, const EventBuffer &event_buffer)
+    {
+        m_thread.push_back(ThreadTally{ name, &event_buffer });
+    }
+
+    void start();
+    void stop();
+
+    /// Print the estimates built from the samples taken so far. Call only when stopped.
+    void report() const;
+
+private:
+    struct LockTally
+    {
+        const char *name;
+        const void *lock;
+        LockState (*read)(const void *lock);
+
+        uint64_t samples    = 0;
+        uint64_t contended  = 0;        ///< Both threads interested.
+        uint64_t held[2]    = { 0, 0 }; ///< By each thread.
+        uint64_t waiting[2] = { 0, 0 }; ///< By each thread.
+    };
+
+    struct ThreadTally
+    {
+        const char *name;
+        const EventBuffer *event_buffer;
+
+        uint64_t samples = 0;
+
+        /// The number of samples in which each line was the last to log.
+        std::map<unsigned, uint64_t> line;
+    };
+
+    template <typename Lock>
+    static LockState read_state(const void *lock)
+    {
+        return static_cast<const Lock *>(lock)->state();
+    }
+
+    void run();
+    void sample();
+
+    const uint64_t m_interval_ns;
+
+    std::vector<LockTally> m_lock;
+    std::vector<ThreadTally> m_thread;
+
+    std::thread m_sampler;
+    volatile bool m_stop = false;
+};
+
+#endif // _lock_sampler_h
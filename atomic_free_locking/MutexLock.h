@@ -0,0 +1,50 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _mutex_lock_h
+#define _mutex_lock_h
+
+#include <mutex>
+
+/**
+ * A std::mutex behind the two-thread lock interface of PetersonLock, for use as a parking baseline
+ * in benchmarks and in the harness.
+ *
+ * The wait function is accepted for interface compatibility and ignored; waiters park in the kernel.
+ */
+template <typename WaitFunction>
+class MutexLock
+{
+    std::mutex m_mutex;
+
+public:
+    MutexLock(WaitFunction) {}
+
+    /// Acquire the lock for the specified thread (0 or 1), blocking until it is available.
+    void acquire(bool) { m_mutex.lock(); }
+
+    /// Release the already-acquired lock for the specified thread (0 or 1).
+    void release(bool) { m_mutex.unlock(); }
+};
+
+#endif // _mutex_lock_h
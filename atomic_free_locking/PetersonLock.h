@@ -26,6 +26,19 @@
 
 #include <cstdint>
 #include <cassert>
+#include <type_traits>
+
+#include "CacheLine.h"
+#include "LockHistory.h"
+#include "LockOrder.h"
+#include "Probes.h"
+
+/// A snapshot of a Peterson-style lock's protocol state, for observers such as LockSampler.
+struct LockState
+{
+    bool interested[2];
+    bool thread_priority;
+};
 
 /**
  * An atomic-free lock useful for synchronizing two (and only two!) threads on an x86 system.
@@ -43,8 +56,10 @@
  *
  * The function used to delay while spinning on the lock is also abstracted by a template
  * parameter.
+ *
+ * When the recorded template parameter is set, the lock keeps a LockHistory of its recent owners.
  */
-template <typename WaitFunction, bool fenced>
+template <typename WaitFunction, bool fenced, bool recorded = false>
 class PetersonLock
 {
     /// The function used to wait while spinning for the lock.
@@ -59,6 +74,13 @@ class PetersonLock
      */
     bool m_thread_priority;
 
+    /**
+     * Recent acquisitions and releases, if the lock is recorded. Kept off the cache line the
+     * waiting thread spins on, since the holder writes it on every acquire and release.
+     */
+    using History = typename std::conditional<recorded, LockHistory, NoLockHistory>::type;
+    alignas(recorded ? CACHE_LINE_SIZE : alignof(History)) History m_history;
+
 public:
     PetersonLock(WaitFunction wait_function)
         : m_wait_function(wait_function)
@@ -69,11 +91,23 @@ public:
         // No point in initializing m_thread_priority; no path reads it without first writing it.
     }
 
-    /// Acquire the lock for the specified thread (0 or 1), spinning until it is available.
-    void acquire(bool thread)
+    ~PetersonLock()
+    {
+        LOCK_ORDER_FORGET(this);
+    }
+
+    /**
+     * Acquire the lock for the specified thread (0 or 1), spinning until it is available.
+     *
+     * Returns the number of times the wait function was called, a cheap measure of contention.
+     */
+    unsigned acquire(bool thread)
     {
         assert(!m_interested[thread]);
 
+        PROBE2(lock__acquire__start, this, thread);
+        LOCK_ORDER_ACQUIRE(this);
+
         const bool other_thread = !thread;
 
         // Announce our interest, but graciously allow the other thread to go first.
@@ -96,9 +130,23 @@ public:
         // other's interest when executing concurrently. If both threads think they're the only
         // one interested, then they'll both think they have the lock and allow the calling
         // code to enter the critical section in both threads.
-        while (m_interested[other_thread] && m_thread_priority == other_thread) {
-            m_wait_function();
+        unsigned spins = 0;
+
+        if (m_interested[other_thread] && m_thread_priority == other_thread) {
+            PROBE2(lock__spin__start, this, thread);
+
+            do {
+                m_wait_function();
+                ++spins;
+            } while (m_interested[other_thread] && m_thread_priority == other_thread);
+
+            PROBE3(lock__spin__end, this, thread, spins);
         }
+
+        PROBE3(lock__acquired, this, thread, spins);
+        m_history.record_acquire(thread, spins);
+
+        return spins;
     }
 
     /// Release the already-acquired lock for the specified thread (0 or 1).
@@ -106,8 +154,29 @@ public:
     {
         assert(m_interested[thread]);
 
+        m_history.record_release(thread);
         m_interested[thread] = false;
+
+        LOCK_ORDER_RELEASE(this);
+        PROBE2(lock__released, this, thread);
     }
+
+    /**
+     * Read the lock's protocol state without writing anything, for use from other threads.
+     *
+     * The fields are read one at a time, so the snapshot may be inconsistent if the lock is
+     * changing hands.
+     */
+    LockState state() const
+    {
+        const volatile bool *interested = m_interested;
+        const volatile bool &thread_priority = m_thread_priority;
+
+        return LockState{ { interested[0], interested[1] }, thread_priority };
+    }
+
+    /// This lock's ownership history, or null if it isn't recorded.
+    const LockHistory *history() const { return m_history.get(); }
 };
 
 #endif // _peterson_lock_h
@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <thread>
+
+#include "Benchmarks.h"
+#include "Latency.h"
+#include "PetersonLock.h"
+#include "PriorityLock.h"
+
+using std::this_thread::yield;
+using WaitFunction = __typeof__(&yield);
+
+namespace {
+
+/// The priority class of each thread. Thread 0 is latency critical; thread 1 is background work.
+const unsigned thread_class[2] = { 1, 0 };
+
+/// Work done inside and outside of the critical section, in iterations of think().
+const unsigned CRITICAL_WORK = 100;
+const unsigned OUTSIDE_WORK  = 50;
+
+/// Declare a thread's priority class, for the locks which have them.
+template <typename Lock>
+void declare_class(Lock &, bool, unsigned) {}
+
+template <typename WaitFunction, bool fenced, typename Policy>
+void declare_class(PriorityPetersonLock<WaitFunction, fenced, Policy> &lock,
+                   bool thread,
+                   unsigned priority_class)
+{
+    lock.set_priority_class(thread, priority_class);
+}
+
+/**
+ * Hammer the specified lock from two threads of different classes, summarizing the acquire
+ * latency of each thread.
+ */
+template <typename Lock>
+void time_lock(const char *lock_name, unsigned loop_count)
+{
+    Lock lock(&yield);
+
+    TwoThreadResult result = time_two_threads(lock, loop_count, CRITICAL_WORK, OUTSIDE_WORK,
+                                              [&](bool thread)
+    {
+        declare_class(lock, thread, thread_class[thread]);
+    });
+
+    if (result.violated) {
+        printf("%s: lock violation detected!\n", lock_name);
+    }
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        const LatencySummary summary = summarize_latency(result.latency[tid]);
+
+        printf("%-10s %6u %10.0f %10.0f %10.0f %10.0f %12.0f\n",
+               lock_name,
+               thread_class[tid],
+               summary.mean,
+               summary.p50,
+               summary.p99,
+               summary.p999,
+               summary.max);
+    }
+}
+
+} // anonymous namespace
+
+void benchmark_priority(unsigned loop_count)
+{
+    printf("Acquire latency by priority class (ns), %u iterations per thread\n", loop_count);
+    printf("%-10s %6s %10s %10s %10s %10s %12s\n",
+           "lock", "class", "mean", "p50", "p99", "p99.9", "max");
+
+    time_lock<PetersonLock<WaitFunction, true>>("peterson", loop_count);
+    time_lock<PriorityPetersonLock<WaitFunction, true>>("priority", loop_count);
+}
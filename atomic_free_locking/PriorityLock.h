@@ -0,0 +1,166 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _priority_lock_h
+#define _priority_lock_h
+
+#include <cstdint>
+#include <cassert>
+
+/**
+ * The default policy for PriorityPetersonLock: a thread defers to a thread of strictly higher
+ * class, but only BYPASS_LIMIT times in a row before insisting on its turn.
+ */
+struct HigherClassFirst
+{
+    static constexpr unsigned BYPASS_LIMIT = 8;
+
+    static bool defers_to(unsigned own_class, unsigned other_class)
+    {
+        return other_class > own_class;
+    }
+};
+
+/**
+ * A PetersonLock in which a thread may declare a priority class, so that when both threads want
+ * the lock, the one of higher class gets it first.
+ *
+ * It's tempting to simply have the higher class thread keep m_thread_priority for itself rather
+ * than graciously handing it to the other thread, but that breaks mutual exclusion: the algorithm
+ * depends on the thread which announces itself last being the one to wait. Instead, the lower
+ * class thread steps aside. If after announcing its interest it sees the higher class thread
+ * interested too, it withdraws its own interest, which is always safe, and waits for the other
+ * thread to take a turn before announcing itself again.
+ *
+ * Deferring is bounded: after the policy's BYPASS_LIMIT consecutive deferrals, a thread acquires
+ * as in the plain PetersonLock, which guarantees it the next turn. So the lower class thread waits
+ * for at most BYPASS_LIMIT + 1 of the other thread's critical sections.
+ *
+ * Deferral is detected through a per-thread release count, which only its own thread writes, so
+ * no atomic RMW is needed.
+ */
+template <typename WaitFunction, bool fenced, typename Policy = HigherClassFirst>
+class PriorityPetersonLock
+{
+    /// The function used to wait while spinning for the lock.
+    WaitFunction m_wait_function;
+
+    /// For both threads, whether the thread is currently acquiring or has acquired the lock.
+    volatile bool m_interested[2];
+
+    /// Which thread has priority for the lock; see PetersonLock.
+    volatile bool m_thread_priority;
+
+    /// For both threads, its declared priority class. Only written by its own thread.
+    volatile unsigned m_class[2];
+
+    /// For both threads, the number of times it has released the lock. Only written by its own thread.
+    volatile uint32_t m_release_count[2];
+
+    /// For both threads, how many times in a row it has deferred. Private to its own thread.
+    unsigned m_bypass_count[2];
+
+public:
+    PriorityPetersonLock(WaitFunction wait_function)
+        : m_wait_function(wait_function)
+    {
+        for (unsigned thread = 0; thread < 2; ++thread) {
+            m_interested[thread] = false;
+            m_class[thread] = 0;
+            m_release_count[thread] = 0;
+            m_bypass_count[thread] = 0;
+        }
+    }
+
+    /// Declare the priority class of the specified thread. Higher classes go first.
+    void set_priority_class(bool thread, unsigned priority_class)
+    {
+        m_class[thread] = priority_class;
+    }
+
+    /**
+     * Acquire the lock for the specified thread (0 or 1), spinning until it is available.
+     *
+     * Returns the number of times the wait function was called, a cheap measure of contention.
+     */
+    unsigned acquire(bool thread)
+    {
+        assert(!m_interested[thread]);
+
+        const bool other_thread = !thread;
+        unsigned spins = 0;
+
+        while (true) {
+            // Announce our interest exactly as PetersonLock does.
+            m_interested[thread] = true;
+            m_thread_priority = other_thread;
+
+            if (fenced) {
+                asm volatile("mfence" ::: "memory");
+            }
+
+            if (!m_interested[other_thread] ||
+                m_bypass_count[thread] >= Policy::BYPASS_LIMIT ||
+                !Policy::defers_to(m_class[thread], m_class[other_thread]))
+            {
+                break;
+            }
+
+            // Step aside until the other thread has had its turn, or has lost interest.
+            const uint32_t release_count = m_release_count[other_thread];
+
+            m_interested[thread] = false;
+            ++m_bypass_count[thread];
+
+            while (m_interested[other_thread] && m_release_count[other_thread] == release_count) {
+                m_wait_function();
+                ++spins;
+            }
+        }
+
+        while (m_interested[other_thread] && m_thread_priority == other_thread) {
+            m_wait_function();
+            ++spins;
+        }
+
+        m_bypass_count[thread] = 0;
+
+        // Keep the compiler from hoisting the critical section above the loop.
+        asm volatile("" ::: "memory");
+
+        return spins;
+    }
+
+    /// Release the already-acquired lock for the specified thread (0 or 1).
+    void release(bool thread)
+    {
+        assert(m_interested[thread]);
+
+        asm volatile("" ::: "memory");
+
+        m_release_count[thread] = m_release_count[thread] + 1;
+        m_interested[thread] = false;
+    }
+};
+
+#endif // _priority_lock_h
@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "Benchmarks.h"
+#include "EventBuffer.h"
+#include "PetersonLock.h"
+#include "Probes.h"
+
+using std::this_thread::yield;
+
+namespace {
+
+using clock = std::chrono::high_resolution_clock;
+
+double ns_per_iteration(clock::time_point start, unsigned loop_count)
+{
+    return std::chrono::duration<double, std::nano>(clock::now() - start).count() / loop_count;
+}
+
+/// An empty loop, kept from being optimized away by a compiler barrier.
+__attribute__((noinline)) double time_empty_loop(unsigned loop_count)
+{
+    const auto start = clock::now();
+
+    for (unsigned i = 0; i < loop_count; ++i) {
+        asm volatile("" ::: "memory");
+    }
+
+    return ns_per_iteration(start, loop_count);
+}
+
+/// The same loop with a three argument probe in it.
+__attribute__((noinline)) double time_probe_loop(unsigned loop_count)
+{
+    const auto start = clock::now();
+
+    for (unsigned i = 0; i < loop_count; ++i) {
+        asm volatile("" ::: "memory");
+        PROBE3(benchmark__probe, &start, i, loop_count);
+    }
+
+    return ns_per_iteration(start, loop_count);
+}
+
+/// The harness's single threaded hot path: an uncontended acquire/release cycle plus logging.
+__attribute__((noinline)) double time_lock_loop(unsigned loop_count)
+{
+    PetersonLock<__typeof__(&yield), true> lock(&yield);
+    EventBuffer events;
+
+    const auto start = clock::now();
+
+    for (unsigned i = 0; i < loop_count; ++i) {
+        LOG(events, "Acquiring lock...");
+        lock.acquire(false);
+        LOG(events, "Acquiring lock...done");
+        LOG(events, "Releasing lock");
+        lock.release(false);
+    }
+
+    return ns_per_iteration(start, loop_count);
+}
+
+} // anonymous namespace
+
+void benchmark_probes(unsigned loop_count)
+{
+#if USDT_PROBES_ENABLED
+    printf("USDT probes are compiled in; run without a tracer attached to measure detached cost\n");
+#else
+    printf("USDT probes are compiled out; <sys/sdt.h> is unavailable or DISABLE_USDT_PROBES is set\n");
+#endif
+
+    const double empty = time_empty_loop(loop_count);
+    const double probe = time_probe_loop(loop_count);
+    const double lock  = time_lock_loop(loop_count);
+
+    printf("%-28s %8.3f ns/iteration\n", "empty loop", empty);
+    printf("%-28s %8.3f ns/iteration\n", "loop with one probe", probe);
+    printf("%-28s %8.3f ns/probe\n", "detached probe cost", probe - empty);
+    printf("%-28s %8.3f ns/iteration\n", "acquire/release with LOGs", lock);
+    printf("Compare the last figure against a build with -DDISABLE_USDT_PROBES.\n");
+}
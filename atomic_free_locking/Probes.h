@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _probes_h
+#define _probes_h
+
+/**
+ * USDT static probes, for observing the locks and event buffers from dtrace, bpftrace or perf
+ * without recompiling.
+ *
+ * Each probe site compiles to a single NOP plus a note recording where its arguments live; the
+ * tracer patches the NOP into a trap only while attached. Arguments should therefore be values
+ * which are already at hand, never anything computed just for the probe. The tracer timestamps
+ * every firing itself.
+ *
+ * Probes are compiled in whenever <sys/sdt.h> is available (it ships with macOS, and with
+ * systemtap-sdt-dev on Linux), unless DISABLE_USDT_PROBES is defined.
+ *
+ * Probe names use the dtrace convention of a double underscore for a dash, so
+ * PROBE2(lock__acquired, ...) shows up as atomic_free_locking:::lock-acquired. The full list:
+ *
+ *   lock-acquire-start (lock, thread)          PetersonLock::acquire called
+ *   lock-spin-start    (lock, thread)          The other thread has priority; about to spin
+ *   lock-spin-end      (lock, thread, spins)   Done spinning after calling the wait function
+ *   lock-acquired      (lock, thread, spins)   Lock acquired
+ *   lock-released      (lock, thread)          PetersonLock::release called
+ *   event-buffer-wrap  (buffer, tier, timestamp)
+ *                                              One of an EventBuffer's tiers wrapped around, starting
+ *                                              to overwrite its oldest events
+ */
+
+#if !defined(DISABLE_USDT_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define USDT_PROBES_ENABLED 1
+#endif
+#endif
+
+#if USDT_PROBES_ENABLED
+#include <sys/sdt.h>
+
+#define PROBE1(name, a)       DTRACE_PROBE1(atomic_free_locking, name, a)
+#define PROBE2(name, a, b)    DTRACE_PROBE2(atomic_free_locking, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(atomic_free_locking, name, a, b, c)
+#else
+#define PROBE1(name, a)       do {} while (0)
+#define PROBE2(name, a, b)    do {} while (0)
+#define PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif // _probes_h
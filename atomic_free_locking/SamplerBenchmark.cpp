@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Steven Bloemer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <thread>
+
+#include "Benchmarks.h"
+#include "EventBuffer.h"
+#include "Latency.h"
+#include "LockSampler.h"
+#include "PetersonLock.h"
+
+using std::this_thread::yield;
+
+namespace {
+
+/// Sample every 10us.
+const uint64_t SAMPLE_INTERVAL_NS = 10'000;
+
+/// Work done inside and outside of the critical section by each thread, in iterations of think().
+/// Thread 0 holds the lock for long stretches; thread 1 mostly works on its own.
+const unsigned critical_work[2] = { 400, 100 };
+const unsigned outside_work[2]  = { 100, 400 };
+
+} // anonymous namespace
+
+void benchmark_sampler(unsigned loop_count)
+{
+    PetersonLock<__typeof__(&yield), true> lock(&yield);
+    EventBuffer event_buffer[2];
+    std::thread thread[2];
+    LockSampler sampler(SAMPLE_INTERVAL_NS);
+
+    sampler.add_lock("peterson", lock);
+    sampler.add_thread("0", event_buffer[0]);
+    sampler.add_thread("1", event_buffer[1]);
+
+    printf("Sampling a lock every %llu ns, %u iterations per thread\n",
+           (unsigned long long)SAMPLE_INTERVAL_NS, loop_count);
+    printf("Thread 0 critical/outside work: %u/%u; thread 1: %u/%u\n",
+           critical_work[0], outside_work[0], critical_work[1], outside_work[1]);
+
+    sampler.start();
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid] = std::thread([&, tid]()
+        {
+            EventBuffer &events = event_buffer[tid];
+
+            for (unsigned i = 0; i < loop_count; ++i) {
+                LOG(events, "Acquiring lock...");
+                lock.acquire(bool(tid));
+                LOG(events, "Acquiring lock...done");
+
+                think(critical_work[tid]);
+
+                LOG(events, "Releasing lock");
+                lock.release(bool(tid));
+
+                think(outside_work[tid]);
+            }
+        });
+    }
+
+    for (unsigned tid = 0; tid < 2; ++tid) {
+        thread[tid].join();
+    }
+
+    sampler.stop();
+    sampler.report();
+}
@@ -22,27 +22,63 @@
  * THE SOFTWARE.
  */
 #include <chrono>
+#include <algorithm>
 #include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
 
+#include "AdaptiveLock.h"
 #include "PetersonLock.h"
 #include "EventBuffer.h"
+#include "Benchmarks.h"
 
 using std::this_thread::yield;
 
+/**
+ * Define ENABLE_LOCK_HISTORY to have the harness's locks keep a LockHistory, which is interleaved
+ * with the event buffers when a violation is dumped. Off by default, since recording adds clock
+ * reads and compiler barriers to the very race the harness demonstrates.
+ */
+#ifndef ENABLE_LOCK_HISTORY
+#define ENABLE_LOCK_HISTORY 0
+#endif
+
 template <bool fenced>
-using LockType = PetersonLock<__typeof__(&yield), fenced>;
+using LockType = PetersonLock<__typeof__(&yield), fenced, bool(ENABLE_LOCK_HISTORY)>;
 
 using std::mutex;
 using unique_lock = std::unique_lock<std::mutex>;
 using std::condition_variable;
 
 
-static void dump_event_buffers(const EventBuffer event_buffer[2], Event::timestamp_t start_time);
+static void dump_event_buffers(const EventBuffer event_buffer[2],
+                               Event::timestamp_t start_time,
+                               const void *lock = nullptr,
+                               const LockHistory *history = nullptr);
+
+/// Benchmarks which may be selected by name on the command line.
+static const struct
+{
+    const char *name;
+    void (*run)(unsigned loop_count);
+} benchmarks[] = {
+    { "barriers", benchmark_barriers },
+    { "adaptive", benchmark_adaptive_lock },
+    { "interference", benchmark_interference },
+    { "probes", benchmark_probes },
+    { "async", benchmark_async_lock },
+    { "priority", benchmark_priority },
+    { "sampler", benchmark_sampler },
+    { "lease", benchmark_lease },
+    { "epoch", benchmark_epoch },
+    { "calibration", benchmark_calibration },
+};
 
 /**
  * Await a condition using the specified condition variable and predicate.
@@ -77,6 +113,10 @@ void exercise_lock(unsigned loop_count)
 
     volatile int shared_value = 0;
 
+    // The releasing thread's logical time, handed to the next thread to acquire the lock so that
+    // the event buffers can be merged in causal order. Guarded by the lock itself.
+    Event::logical_time_t handoff_time = 0;
+
     // A mutex to guard the violation handling code.
     mutex require_mutex;
 
@@ -95,6 +135,8 @@ void exercise_lock(unsigned loop_count)
         {
             EventBuffer &events = event_buffer[tid];
 
+            LockOrderValidator::set_event_buffer(&events, tid);
+
 #define REQUIRE(condition) do {                                                                     \
     if (!(condition)) {                                                                             \
         handle_violation("Requirement \"" #condition "\" failed at line %u!\n", __LINE__);          \
@@ -112,6 +154,8 @@ void exercise_lock(unsigned loop_count)
              */
             auto handle_violation = [&](const char *failure_message, unsigned line)
             {
+                LOG_RARE(events, "Requirement failed at line %u", line);
+
                 if (require_mutex.try_lock()) {
                     // Stop the other threads
                     stop = true;
@@ -122,21 +166,25 @@ void exercise_lock(unsigned loop_count)
                     printf(failure_message, line);
                     printf("shared_value: %u\n", shared_value);
                     printf("Dumping event buffers:\n");
-                    dump_event_buffers(event_buffer, start_time);
+                    dump_event_buffers(event_buffer, start_time, &lock, lock.history());
                     require_mutex.unlock();
                 }
             };
 
+            LOG_RARE(events, "Starting %u iterations", loop_count);
+
             for (unsigned i = 0; i < loop_count && !stop; ++i) {
                 
                 LOG(events, "Acquiring lock...");
                 lock.acquire(bool(tid));
+                events.receive(handoff_time);
                 LOG(events, "Acquiring lock...done");
 
                 REQUIRE(++shared_value == 1);
                 REQUIRE(--shared_value == 0);
 
                 LOG(events, "Releasing lock");
+                handoff_time = events.send();
                 lock.release(bool(tid));
             }
 
@@ -159,20 +207,50 @@ int main(int argc, const char * argv[])
 
     printf("Running with %u loops per thread\n", loop_count);
 
+    if (argc >= 3) {
+        for (const auto &benchmark : benchmarks) {
+            if (strcmp(argv[2], benchmark.name) == 0) {
+                benchmark.run(loop_count);
+                return 0;
+            }
+        }
+
+        printf("Unknown benchmark \"%s\". Available benchmarks:\n", argv[2]);
+        for (const auto &benchmark : benchmarks) {
+            printf("    %s\n", benchmark.name);
+        }
+        return 1;
+    }
+
     printf("Exercising Peterson lock with fencing\n");
     exercise_lock<LockType<true>>(loop_count);
 
     printf("Exercising Peterson lock without fencing\n");
     exercise_lock<LockType<false>>(loop_count);
 
+    printf("Exercising adaptive lock\n");
+    exercise_lock<AdaptiveLock<__typeof__(&yield)>>(loop_count);
+
     return 0;
 }
 
-static void dump_event_buffers(const EventBuffer event_buffer[2], Event::timestamp_t start_time)
+/**
+ * Dump both threads' event buffers to stdout, merged into one history, newest first.
+ *
+ * If a lock history is supplied, its entries are interleaved with the events. Each entry is placed
+ * just after the latest event its thread logged before it, taking that event's logical time, so
+ * that the whole dump is ordered by logical time.
+ */
+static void dump_event_buffers(const EventBuffer event_buffer[2],
+                               Event::timestamp_t start_time,
+                               const void *lock,
+                               const LockHistory *history)
 {
     const unsigned count = 2;
 
-    // Go through the event buffers in parallel, always printing the entry with the latest timestamp
+    // Go through the event buffers in parallel, always printing the entry with the latest logical
+    // time. Lamport clocks guarantee that an event which causally follows another has the greater
+    // logical time; among concurrent events with equal logical times, the latest timestamp wins.
     EventBuffer::ConstReverseIterator itor[count];
     EventBuffer::ConstReverseIterator end[count];
 
@@ -184,30 +262,79 @@ static void dump_event_buffers(const EventBuffer event_buffer[2], Event::timesta
 
     unsigned latest_itor = count;
 
+    // Lock history entries, as the logical time each is placed at and its age, newest first.
+    using Placement = std::pair<Event::logical_time_t, uint32_t>;
+    std::vector<Placement> placed;
+
+    for (uint32_t age = 0; history && age < LockHistory::HISTORY_SIZE && history->peek(age); ++age) {
+        const LockHistory::Entry &entry = history->peek(age);
+        Event::logical_time_t logical_time = 0;
+
+        if (entry.thread < count) {
+            const EventBuffer &events = event_buffer[entry.thread];
+
+            // A thread's timestamps and logical times increase together, so its latest event
+            // before the entry is the first found going backwards.
+            for (auto event = events.rbegin(); event != events.rend(); ++event) {
+                if (event->timestamp <= entry.timestamp) {
+                    logical_time = event->logical_time;
+                    break;
+                }
+            }
+        }
+
+        placed.emplace_back(logical_time, age);
+    }
+
+    // Placement can disagree with the history's own order for concurrent entries; the dump
+    // sticks to logical time.
+    std::stable_sort(placed.begin(), placed.end(), [](const Placement &a, const Placement &b)
+    {
+        return a.first > b.first;
+    });
+
+    auto next_placed = placed.begin();
+
+    // Print all lock history entries placed at or after the specified logical time.
+    auto dump_history = [&](Event::logical_time_t logical_time)
+    {
+        while (next_placed != placed.end() && next_placed->first >= logical_time) {
+            history->peek(next_placed->second).print(lock, start_time);
+            ++next_placed;
+        }
+    };
+
     while (true)
     {
+        Event::logical_time_t latest_logical_time = 0;
         Event::timestamp_t latest_timestamp = 0;
 
         // latest_itor remains set to count when all iterators are exhausted
         latest_itor = count;
 
-        // Find the iterator containing the most recent timestamp
+        // Find the iterator containing the most recent event
         for (unsigned i = 0; i < count; ++i)
         {
             if (itor[i] != end[i] &&
                 *itor[i] &&
-                itor[i]->timestamp >= latest_timestamp)
+                (itor[i]->logical_time > latest_logical_time ||
+                 (itor[i]->logical_time == latest_logical_time &&
+                  itor[i]->timestamp >= latest_timestamp)))
             {
                 latest_itor = i;
+                latest_logical_time = itor[i]->logical_time;
                 latest_timestamp = itor[i]->timestamp;
             }
         }
 
         if (latest_itor == count) {
-            // All iterators are exhausted; we're done.
+            // All iterators are exhausted; we're done, save any older lock history.
+            dump_history(0);
             break;
         }
 
-        (itor[latest_itor]++)->print(latest_itor, start_time);
+        dump_history(itor[latest_itor]->logical_time);
+        itor[latest_itor]->print(latest_itor, start_time, itor[latest_itor].payload());
+        ++itor[latest_itor];
     }
 }